@@ -0,0 +1,472 @@
+/* -*- linux-c -*-
+ *
+ * Capture archive with an index for queries
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "archive.h"
+#include "output.h"
+#include "npy.h"
+
+static gint name_size(const gchar *name)
+{
+	return (strlen(name) + 7) & ~7;
+}
+
+static gint compare_values(gconstpointer a, gconstpointer b)
+{
+	const struct archive_value *va = a;
+	const struct archive_value *vb = b;
+
+	return va->value < vb->value ? -1 : va->value > vb->value;
+}
+
+/*
+ * Collect the transitions of a signal from the edge index and sum up
+ * the number of samples holding each value. values is left empty if
+ * the signal takes too many values.
+ */
+static void index_signal(struct capture *capture, struct signal_def *signal,
+			 GArray *values, GArray *transitions)
+{
+	GHashTable *counts = g_hash_table_new(NULL, NULL);
+	struct archive_transition *t;
+	GHashTableIter iter;
+	gpointer key, count;
+
+	if (capture->noof_samples == 0)
+		goto done;
+
+	g_array_set_size(transitions, 1);
+	t = &g_array_index(transitions, struct archive_transition, 0);
+	t->sample = 0;
+	t->value = capture_signal_value(signal, capture->samples[0]);
+	for (gint c = 0; c < capture->noof_changes; c++) {
+		struct archive_transition next;
+
+		if (!(capture->changes[c].diff & signal->mask))
+			continue;
+		next.sample = capture->changes[c].sample;
+		next.value = capture_signal_value(
+			signal, capture->samples[next.sample]);
+		g_array_append_val(transitions, next);
+	}
+
+	t = (struct archive_transition *)transitions->data;
+	for (guint i = 0; i < transitions->len; i++) {
+		guint32 end = i + 1 < transitions->len
+			? t[i + 1].sample : (guint32)capture->noof_samples;
+
+		key = GUINT_TO_POINTER(t[i].value);
+		count = g_hash_table_lookup(counts, key);
+		g_hash_table_insert(counts, key, GUINT_TO_POINTER(
+					    GPOINTER_TO_UINT(count)
+					    + end - t[i].sample));
+		if (g_hash_table_size(counts) > ARCHIVE_MAX_VALUES)
+			goto done;
+	}
+
+	g_hash_table_iter_init(&iter, counts);
+	while (g_hash_table_iter_next(&iter, &key, &count)) {
+		struct archive_value v = {
+			.value = GPOINTER_TO_UINT(key),
+			.count = GPOINTER_TO_UINT(count)
+		};
+
+		g_array_append_val(values, v);
+	}
+	g_array_sort(values, compare_values);
+done:
+	g_hash_table_destroy(counts);
+}
+
+static gboolean write_index(struct state *state, struct capture *capture,
+			    gchar *filename)
+{
+	struct archive_header header;
+	GArray **values = g_malloc(MAX(state->noof_signals, 1)
+				   * sizeof(*values));
+	GArray **transitions = g_malloc(MAX(state->noof_signals, 1)
+					* sizeof(*transitions));
+	static const gchar padding[8];
+	struct output *out;
+	gboolean success = FALSE;
+	guint64 offset;
+	gint s;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ARCHIVE_VERSION;
+	header.noof_signals = state->noof_signals;
+	header.noof_samples = capture->noof_samples;
+	header.trigger = capture->trigger;
+	header.sample_rate = state->sample_rate;
+
+	offset = sizeof(header)
+		+ state->noof_signals * sizeof(struct archive_signal);
+	for (s = 0; s < state->noof_signals; s++) {
+		struct signal_def *signal = &state->signals[s];
+
+		values[s] = g_array_new(FALSE, FALSE,
+					sizeof(struct archive_value));
+		transitions[s] = g_array_new(FALSE, FALSE,
+					     sizeof(struct archive_transition));
+		index_signal(capture, signal, values[s], transitions[s]);
+	}
+
+	out = output_open(filename, FALSE, 0);
+	if (out == NULL)
+		goto done;
+	output_write(out, &header, sizeof(header));
+	for (s = 0; s < state->noof_signals; s++) {
+		struct signal_def *signal = &state->signals[s];
+		struct archive_signal sig = {
+			.offset = offset,
+			.name_length = strlen(signal->name),
+			.noof_bits = signal->noof_bits,
+			.noof_values = values[s]->len,
+			.noof_transitions = transitions[s]->len
+		};
+
+		output_write(out, &sig, sizeof(sig));
+		offset += name_size(signal->name)
+			+ values[s]->len * sizeof(struct archive_value)
+			+ transitions[s]->len
+			* sizeof(struct archive_transition);
+	}
+	for (s = 0; s < state->noof_signals; s++) {
+		struct signal_def *signal = &state->signals[s];
+		gint length = strlen(signal->name);
+
+		output_write(out, signal->name, length);
+		output_write(out, padding, name_size(signal->name) - length);
+		output_write(out, values[s]->data,
+			     values[s]->len * sizeof(struct archive_value));
+		output_write(out, transitions[s]->data,
+			     transitions[s]->len
+			     * sizeof(struct archive_transition));
+	}
+	success = output_close(out);
+done:
+	for (s = 0; s < state->noof_signals; s++) {
+		g_array_free(values[s], TRUE);
+		g_array_free(transitions[s], TRUE);
+	}
+	g_free(values);
+	g_free(transitions);
+	return success;
+}
+
+gboolean archive_store(struct state *state, struct capture *capture)
+{
+	GDateTime *now = g_date_time_new_now_local();
+	gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+	gchar *name = g_strdup_printf("%s.%06d", stamp,
+				      g_date_time_get_microsecond(now));
+	gchar *dir = g_build_filename(state->archive_dir, name, NULL);
+	gchar *filename;
+	gboolean success = FALSE;
+
+	g_date_time_unref(now);
+	g_free(stamp);
+	g_free(name);
+
+	if (g_mkdir_with_parents(dir, 0777) != 0) {
+		perror(dir);
+		goto error;
+	}
+
+	success = TRUE;
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+		gint size = npy_element_size(s->noof_bits);
+		void *column = npy_signal_column(capture, s, size);
+
+		name = g_strdup_printf("%s.npy", s->name);
+		filename = g_build_filename(dir, name, NULL);
+		success = npy_write(filename, 'u', size,
+				    capture->noof_samples, column) && success;
+		g_free(filename);
+		g_free(name);
+		g_free(column);
+	}
+
+	filename = g_build_filename(dir, ARCHIVE_INDEX, NULL);
+	success = write_index(state, capture, filename) && success;
+	g_free(filename);
+error:
+	g_free(dir);
+	return success;
+}
+
+/* <signal>=<value> or <signal>!=<value>, optionally @<from>..<to> */
+struct predicate {
+	gchar *signal;
+	gboolean equal;
+	guint32 value;
+	gboolean windowed;
+	/* The window relative to the trigger in samples or seconds */
+	gdouble bound[2];
+	gboolean is_time[2];
+};
+
+static gboolean parse_bound(gchar *text, gdouble *bound, gboolean *is_time)
+{
+	static const struct {
+		gchar *suffix;
+		gdouble scale;
+	} units[] = {
+		{ "s", 1 },
+		{ "ms", 0.001 },
+		{ "us", 0.000001 },
+		{ "ns", 0.000000001 },
+		{ "ps", 0.000000000001 }
+	};
+	gchar *tail;
+
+	*bound = strtod(text, &tail);
+	*is_time = FALSE;
+	if (tail == text)
+		return FALSE;
+	if (*tail == 0)
+		return TRUE;
+	for (gint i = 0; i < G_N_ELEMENTS(units); i++)
+		if (strcasecmp(tail, units[i].suffix) == 0) {
+			*bound *= units[i].scale;
+			*is_time = TRUE;
+			return TRUE;
+		}
+	return FALSE;
+}
+
+static gboolean parse_predicate(gchar *text, struct predicate *p)
+{
+	gchar *op = strchr(text, '=');
+	gchar *window, *range, *tail;
+
+	if (op == NULL || op == text)
+		goto error;
+	p->equal = op[-1] != '!';
+	p->signal = g_strndup(text, op - text - !p->equal);
+
+	p->value = strtoul(op + 1, &tail, 0);
+	if (tail == op + 1 || (*tail != 0 && *tail != '@'))
+		goto error;
+
+	p->windowed = *tail == '@';
+	if (!p->windowed)
+		return TRUE;
+	window = g_strdup(tail + 1);
+	range = strstr(window, "..");
+	if (range != NULL)
+		*range = 0;
+	if (range == NULL
+	    || !parse_bound(window, &p->bound[0], &p->is_time[0])
+	    || !parse_bound(range + 2, &p->bound[1], &p->is_time[1])) {
+		g_free(window);
+		goto error;
+	}
+	g_free(window);
+	return TRUE;
+error:
+	fprintf(stderr,
+		"Cannot parse query \"%s\", expected "
+		"<signal>=<value>[@<from>..<to>]\n", text);
+	return FALSE;
+}
+
+/*
+ * Return the data of a signal in the mapped index, or NULL if the
+ * file is too short to hold it.
+ */
+static const gchar *signal_data(const gchar *base, gsize length,
+				const struct archive_signal *sig)
+{
+	guint64 size = ((sig->name_length + 7) & ~7)
+		+ (guint64)sig->noof_values * sizeof(struct archive_value)
+		+ (guint64)sig->noof_transitions
+		* sizeof(struct archive_transition);
+
+	if (sig->offset > length || size > length - sig->offset)
+		return NULL;
+	return base + sig->offset;
+}
+
+static gint window_sample(const struct archive_header *header,
+			  gdouble bound, gboolean is_time)
+{
+	if (is_time)
+		bound *= header->sample_rate;
+	return CLAMP(header->trigger + bound, -1.0,
+		     (gdouble)header->noof_samples);
+}
+
+/*
+ * Check the value summary first, which settles most predicates
+ * without looking at the transitions.
+ */
+static gboolean match_signal(const struct archive_header *header,
+			     const struct archive_signal *sig,
+			     const gchar *data, struct predicate *p)
+{
+	const struct archive_value *values = (const void *)
+		(data + ((sig->name_length + 7) & ~7));
+	const struct archive_transition *t = (const void *)
+		(values + sig->noof_values);
+	gint from = 0, to = header->noof_samples - 1;
+	gint lo, hi;
+
+	if (p->windowed) {
+		from = MAX(window_sample(header, p->bound[0], p->is_time[0]),
+			   from);
+		to = MIN(window_sample(header, p->bound[1], p->is_time[1]),
+			 to);
+	}
+	if (from > to || sig->noof_transitions == 0)
+		return FALSE;
+
+	if (sig->noof_values > 0) {
+		struct archive_value key = { .value = p->value };
+		gboolean present = bsearch(&key, values, sig->noof_values,
+					   sizeof(key), compare_values)
+			!= NULL;
+		gboolean whole = from == 0 && to == header->noof_samples - 1;
+
+		if (p->equal && !present)
+			return FALSE;
+		if (!p->equal && present && sig->noof_values == 1)
+			return FALSE;
+		if (whole)
+			return TRUE;
+	}
+
+	/* The last transition at or before the start of the window */
+	for (lo = 0, hi = sig->noof_transitions; hi - lo > 1;) {
+		gint mid = (lo + hi) / 2;
+
+		if (t[mid].sample <= from)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	for (; lo < sig->noof_transitions && t[lo].sample <= to; lo++)
+		if ((t[lo].value == p->value) == p->equal)
+			return TRUE;
+	return FALSE;
+}
+
+static gboolean match_capture(GMappedFile *file,
+			      struct predicate *predicates, gint noof)
+{
+	const gchar *base = g_mapped_file_get_contents(file);
+	gsize length = g_mapped_file_get_length(file);
+	const struct archive_header *header = (const void *)base;
+	const struct archive_signal *sigs = (const void *)(header + 1);
+
+	if (length < sizeof(*header)
+	    || memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic))
+	    || header->version != ARCHIVE_VERSION
+	    || header->noof_signals > (length - sizeof(*header))
+	    / sizeof(*sigs))
+		return FALSE;
+
+	for (gint i = 0; i < noof; i++) {
+		gboolean found = FALSE;
+
+		for (guint s = 0; s < header->noof_signals && !found; s++) {
+			const gchar *data = signal_data(base, length,
+							&sigs[s]);
+
+			if (data == NULL
+			    || sigs[s].name_length != strlen(
+				    predicates[i].signal)
+			    || memcmp(data, predicates[i].signal,
+				      sigs[s].name_length) != 0)
+				continue;
+			found = TRUE;
+			if (!match_signal(header, &sigs[s], data,
+					  &predicates[i]))
+				return FALSE;
+		}
+		if (!found)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+gboolean archive_query(struct state *state)
+{
+	gint noof = g_strv_length(state->queries);
+	struct predicate *predicates = g_malloc0(noof * sizeof(*predicates));
+	GList *matches = NULL;
+	GError *error = NULL;
+	gboolean success = FALSE;
+	const gchar *name;
+	GDir *dir = NULL;
+
+	for (gint i = 0; i < noof; i++)
+		if (!parse_predicate(state->queries[i], &predicates[i]))
+			goto error;
+
+	dir = g_dir_open(state->archive_dir, 0, &error);
+	if (dir == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		goto error;
+	}
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		gchar *filename = g_build_filename(state->archive_dir, name,
+						   ARCHIVE_INDEX, NULL);
+		GMappedFile *file;
+
+		if (!g_file_test(filename, G_FILE_TEST_IS_REGULAR)) {
+			g_free(filename);
+			continue;
+		}
+		file = g_mapped_file_new(filename, FALSE, &error);
+		if (file == NULL) {
+			fprintf(stderr, "%s\n", error->message);
+			g_clear_error(&error);
+		} else {
+			if (match_capture(file, predicates, noof))
+				matches = g_list_prepend(matches,
+							 g_strdup(name));
+			g_mapped_file_unref(file);
+		}
+		g_free(filename);
+	}
+
+	/* The names sort in time order */
+	matches = g_list_sort(matches, (GCompareFunc)strcmp);
+	for (GList *i = matches; i != NULL; i = g_list_next(i))
+		printf("%s\n", (gchar *)i->data);
+	success = TRUE;
+error:
+	if (dir != NULL)
+		g_dir_close(dir);
+	g_list_free_full(matches, g_free);
+	for (gint i = 0; i < noof; i++)
+		g_free(predicates[i].signal);
+	g_free(predicates);
+	return success;
+}
@@ -0,0 +1,92 @@
+/* -*- linux-c -*-
+ *
+ * Capture archive with an index for queries
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+#include "state.h"
+#include "capture.h"
+
+/*
+ * Every capture in an archive is a directory named after the time of
+ * the capture. It holds one NumPy array per signal, <signal>.npy, and
+ * an index file named ARCHIVE_INDEX with the layout, all fields in
+ * native byte order:
+ *
+ *   struct archive_header
+ *   struct archive_signal[noof_signals]
+ *   For each signal, at the offset given by its archive_signal:
+ *     The name, padded with zeros to a multiple of 8 bytes
+ *     struct archive_value[noof_values]
+ *     struct archive_transition[noof_transitions]
+ *
+ * The values are the distinct values of the signal sorted by value,
+ * with the number of samples holding each. If the signal takes more
+ * than ARCHIVE_MAX_VALUES values noof_values is 0. The transitions
+ * are the samples at which the signal changes value together with the
+ * new value, the first one is the value at sample 0.
+ */
+
+#define ARCHIVE_INDEX "index"
+#define ARCHIVE_MAGIC "OBLSCIDX"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_MAX_VALUES 256
+
+struct archive_header {
+	gchar magic[8];
+	guint32 version;
+	guint32 noof_signals;
+	guint32 noof_samples;
+	gint32 trigger;
+	gdouble sample_rate;
+};
+
+struct archive_signal {
+	guint64 offset; /* From the start of the file */
+	guint32 name_length;
+	guint32 noof_bits;
+	guint32 noof_values;
+	guint32 noof_transitions;
+};
+
+struct archive_value {
+	guint32 value;
+	guint32 count;
+};
+
+struct archive_transition {
+	guint32 sample;
+	guint32 value;
+};
+
+/* Store the capture in a new directory in the archive */
+gboolean archive_store(struct state *state, struct capture *capture);
+
+/*
+ * Print the names of the captures in the archive matching all the
+ * query predicates, using only the index files. Return FALSE on
+ * error.
+ */
+gboolean archive_query(struct state *state);
+
+#endif /* _ARCHIVE_H_ */
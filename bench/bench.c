@@ -0,0 +1,443 @@
+/* -*- linux-c -*-
+ *
+ * Benchmarks of decoding, encoding, trigger compilation and capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "state.h"
+#include "cmdline.h"
+#include "capture.h"
+#include "device.h"
+#include "trigger.h"
+#include "vcd.h"
+#include "decode.h"
+#include "emulator.h"
+
+#define BENCH_TIME 0.2 /* s, the least time each measurement runs for */
+
+/* The probability that a channel changes value between two samples */
+static const gdouble densities[] = { 0.001, 0.05, 0.5 };
+
+static const gint bus_widths[] = { 1, 8, 32 };
+
+/* Over the signals clk:0 and bus:8-1 */
+static const gchar *trigger_specs[] = {
+	"[clk=1]",
+	"{[clk=1], [bus=0x12]}",
+	"([clk=0], [clk=1], [bus=5])",
+	"clk=[0/20ns, 1/20ns]"
+};
+
+/* Sent back to back on tx:0, repeated to fill the capture */
+static const guint8 uart_bytes[] = { 0x55, 0xa3, 0x0f, 0x81, 0x42 };
+
+/* Samples per bit of a transmitter running fast, 10 is nominal */
+#define UART_BIT_TIME 9.7
+
+/* Channel group combinations of the device capture benchmark */
+static const guint32 device_groups[] = { 0x1, 0x3, 0xF };
+
+struct run {
+	struct state state;
+	guint8 *buffer;
+	struct capture *capture;
+	struct decode *decode;
+	gint port;
+};
+
+typedef void (*bench_fun)(struct run *run);
+
+static gchar *config_file; /* Empty, so only the defaults are used */
+
+/*
+ * Set up the state from space separated command line options. The
+ * baud rate does not matter to the emulated device, but it must be
+ * one that is accepted.
+ */
+static void setup(struct state *state, const gchar *options)
+{
+	gchar *line = g_strdup_printf("oblsc-bench -C %s -B 1152000 %s",
+				      config_file, options);
+	gchar **argv = g_strsplit(line, " ", -1);
+
+	setup_configuration(g_strv_length(argv), argv, state);
+	g_free(line);
+}
+
+/* Options defining one 8 bit signal for each group set in groups */
+static gchar *group_signals(guint32 groups)
+{
+	GString *s = g_string_new("");
+
+	for (gint g = 0; g < 4; g++)
+		if (groups & (1 << g))
+			g_string_append_printf(s, " -s g%d:%d-%d", g,
+					       8 * g + 7, 8 * g);
+	return g_string_free(s, FALSE);
+}
+
+static gchar *group_name(guint32 groups)
+{
+	GString *s = g_string_new("");
+
+	for (gint g = 0; g < 4; g++)
+		if (groups & (1 << g))
+			g_string_append_printf(s, "%d", g);
+	return g_string_free(s, FALSE);
+}
+
+static guint32 next_random(guint32 *x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+	return *x;
+}
+
+/*
+ * A raw buffer as read from the device, where each channel in use
+ * changes value between two samples with the probability density.
+ * The same density always gives the same buffer.
+ */
+static guint8 *make_buffer(struct state *state, gdouble density)
+{
+	gint groups = state_noof_channel_groups_in_use(state);
+	gint size = state_buffer_capacity(state) * groups;
+	guint8 *buffer = g_malloc0(size);
+	guint32 threshold = density * G_MAXUINT32;
+	guint32 seed = 2463534242U;
+
+	for (gint i = groups; i < size; i++) {
+		buffer[i] = buffer[i - groups];
+		for (gint bit = 0; bit < 8; bit++)
+			if (next_random(&seed) < threshold)
+				buffer[i] ^= 1 << bit;
+	}
+	return buffer;
+}
+
+/* Return the mean time in seconds of runs of fun over BENCH_TIME */
+static gdouble measure(bench_fun fun, struct run *run)
+{
+	gint64 start = g_get_monotonic_time();
+	gint64 now;
+	gint runs = 0;
+
+	do {
+		fun(run);
+		runs++;
+		now = g_get_monotonic_time();
+	} while (now - start < BENCH_TIME * 1e6);
+	return (now - start) / 1e6 / runs;
+}
+
+static void decode(struct run *run)
+{
+	capture_free(capture_new(&run->state, run->buffer));
+}
+
+static void encode(struct run *run)
+{
+	if (!vcd_dump(&run->state, run->capture)) {
+		fprintf(stderr, "Failed to write VCD\n");
+		exit(1);
+	}
+}
+
+static void uart(struct run *run)
+{
+	if (!decode_run(run->decode, run->capture)) {
+		fprintf(stderr, "Failed to decode\n");
+		exit(1);
+	}
+}
+
+static void compile(struct run *run)
+{
+	if (!trigger_compile(&run->state)) {
+		fprintf(stderr, "Failed to compile %s\n",
+			run->state.trigger_spec);
+		exit(1);
+	}
+}
+
+static void compile_uncached(struct run *run)
+{
+	trigger_forget();
+	compile(run);
+}
+
+static void capture(struct run *run)
+{
+	guint8 *buffer = device_capture(run->port, &run->state);
+
+	if (buffer == NULL)
+		exit(1);
+	run->capture = capture_new(&run->state, buffer);
+	g_free(buffer);
+	encode(run);
+	capture_free(run->capture);
+}
+
+/* Unpacking raw buffers into captures, for every channel group set */
+static void bench_decode(void)
+{
+	for (guint32 groups = 1; groups < 16; groups++) {
+		gchar *signals = group_signals(groups);
+		gchar *name = group_name(groups);
+		struct run run;
+
+		setup(&run.state, signals);
+		for (gint d = 0; d < G_N_ELEMENTS(densities); d++) {
+			gint n = state_buffer_capacity(&run.state);
+			gdouble t;
+
+			run.buffer = make_buffer(&run.state, densities[d]);
+			t = measure(decode, &run);
+			printf("decode   groups %-4s  density %-5g  "
+			       "%8.2f Msamples/s  %8.2f MB/s\n",
+			       name, densities[d], n / t / 1e6,
+			       n * state_noof_channel_groups_in_use(&run.state)
+			       / t / 1e6);
+			g_free(run.buffer);
+		}
+		g_free(name);
+		g_free(signals);
+	}
+}
+
+/* Writing VCD with all channels in use split into buses */
+static void bench_encode(void)
+{
+	gchar *vcd_file;
+	gint fd = g_file_open_tmp("oblsc-bench-XXXXXX.vcd", &vcd_file, NULL);
+
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create a temporary file\n");
+		exit(1);
+	}
+	close(fd);
+
+	for (gint w = 0; w < G_N_ELEMENTS(bus_widths); w++) {
+		gint width = bus_widths[w];
+		GString *options = g_string_new("-o /dev/null");
+		struct run run;
+
+		for (gint c = 0; c < 32; c += width)
+			g_string_append_printf(options, " -s b%d:%d-%d",
+					       c, c + width - 1, c);
+		setup(&run.state, options->str);
+		for (gint d = 0; d < G_N_ELEMENTS(densities); d++) {
+			gint n = state_buffer_capacity(&run.state);
+			struct stat st;
+			gdouble t;
+
+			run.buffer = make_buffer(&run.state, densities[d]);
+			run.capture = capture_new(&run.state, run.buffer);
+			/* The size is taken from a real file */
+			run.state.outfile = vcd_file;
+			encode(&run);
+			run.state.outfile = "/dev/null";
+			stat(vcd_file, &st);
+			t = measure(encode, &run);
+			printf("encode   width %-2d  density %-5g  "
+			       "%8.2f Msamples/s  %8.2f MB/s\n",
+			       width, densities[d], n / t / 1e6,
+			       st.st_size / t / 1e6);
+			capture_free(run.capture);
+			g_free(run.buffer);
+		}
+		g_string_free(options, TRUE);
+	}
+	unlink(vcd_file);
+	g_free(vcd_file);
+}
+
+/*
+ * Samples of 8N1 frames of the uart bytes, sent back to back with
+ * UART_BIT_TIME samples per bit. Return the number of whole frames.
+ */
+static gint make_uart_samples(sample_t *samples, gint n)
+{
+	gdouble t = 2 * UART_BIT_TIME;
+	gint frames = 0;
+	gint i;
+
+	for (i = 0; i < t; i++)
+		samples[i] = 1;
+	for (; t + 10 * UART_BIT_TIME < n; t += 10 * UART_BIT_TIME) {
+		guint byte = uart_bytes[frames++ % G_N_ELEMENTS(uart_bytes)];
+		/* Start bit, data least significant bit first, stop bit */
+		guint bits = (1 << 9) | (byte << 1);
+
+		for (gint bit = 0; bit < 10; bit++)
+			for (; i < t + (bit + 1) * UART_BIT_TIME; i++)
+				samples[i] = (bits >> bit) & 1;
+	}
+	for (; i < n; i++)
+		samples[i] = 1;
+	return frames;
+}
+
+/*
+ * Decoding a UART. The decoded bytes are checked first, as a decoder
+ * which loses frames of a transmitter running fast would look fast.
+ */
+static void bench_uart(void)
+{
+	gchar *decode_file;
+	gint fd = g_file_open_tmp("oblsc-bench-XXXXXX.txt", &decode_file,
+				  NULL);
+	struct run run;
+	gchar *contents;
+	gchar **lines;
+	sample_t *samples;
+	gint n, frames;
+	gdouble t;
+
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create a temporary file\n");
+		exit(1);
+	}
+	close(fd);
+
+	setup(&run.state, "-S 1M -s tx:0 -d uart:rx=tx,baud=100000 "
+	      "-o /dev/null");
+	n = state_buffer_capacity(&run.state);
+	samples = g_malloc(n * sizeof(*samples));
+	frames = make_uart_samples(samples, n);
+	run.capture = capture_new_from_samples(&run.state, samples, n, 0);
+	run.decode = decode_setup(&run.state);
+	if (run.decode == NULL)
+		exit(1);
+
+	run.state.decode_outfile = decode_file;
+	uart(&run);
+	if (!g_file_get_contents(decode_file, &contents, NULL, NULL)) {
+		fprintf(stderr, "Failed to read %s\n", decode_file);
+		exit(1);
+	}
+	lines = g_strsplit(contents, "\n", -1);
+	for (gint f = 0; f <= frames; f++) {
+		gchar *expected = f < frames ? g_strdup_printf(
+			" uart0 0x%02x",
+			uart_bytes[f % G_N_ELEMENTS(uart_bytes)])
+			: g_strdup("");
+
+		if (lines[f] == NULL || !g_str_has_suffix(lines[f], expected)
+		    || (f == frames && *lines[f] != 0)) {
+			fprintf(stderr, "Frame %d of the uart was decoded as "
+				"\"%s\", expected \"%s\"\n", f,
+				lines[f] == NULL ? "" : lines[f], expected);
+			exit(1);
+		}
+		g_free(expected);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	unlink(decode_file);
+	g_free(decode_file);
+
+	run.state.decode_outfile = "/dev/null";
+	t = measure(uart, &run);
+	printf("uart     bit time %-4g  %8.2f Msamples/s  %8.2f kframes/s\n",
+	       UART_BIT_TIME, n / t / 1e6, frames / t / 1e3);
+	decode_free(run.decode);
+	capture_free(run.capture);
+}
+
+/* Parsing and allocating hardware triggers, and using the cache */
+static void bench_trigger(void)
+{
+	struct run run;
+
+	setup(&run.state, "-s clk:0 -s bus:8-1");
+	for (gint i = 0; i < G_N_ELEMENTS(trigger_specs); i++) {
+		gdouble cold, warm;
+
+		run.state.trigger_spec = (gchar *)trigger_specs[i];
+		cold = measure(compile_uncached, &run);
+		warm = measure(compile, &run);
+		printf("trigger  %-28s  %8.2f us  %8.3f us cached\n",
+		       trigger_specs[i], cold * 1e6, warm * 1e6);
+	}
+}
+
+/* Capturing from an emulated device and writing VCD */
+static void bench_device(void)
+{
+	struct emulator *emulator = emulator_start();
+
+	if (emulator == NULL)
+		exit(1);
+	for (gint i = 0; i < G_N_ELEMENTS(device_groups); i++) {
+		gchar *signals = group_signals(device_groups[i]);
+		gchar *name = group_name(device_groups[i]);
+		gchar *options = g_strdup_printf("-D %s -o /dev/null%s",
+						 emulator_device(emulator),
+						 signals);
+		struct run run;
+		gint64 start;
+		gdouble open_time, t;
+		gint n;
+
+		setup(&run.state, options);
+		n = state_buffer_capacity(&run.state);
+		start = g_get_monotonic_time();
+		run.port = device_open(&run.state);
+		if (run.port == -1)
+			exit(1);
+		open_time = (g_get_monotonic_time() - start) / 1e6;
+		t = measure(capture, &run);
+		close(run.port);
+		printf("capture  groups %-4s  open %8.2f ms  %8.2f ms/capture"
+		       "  %8.2f Msamples/s\n",
+		       name, open_time * 1e3, t * 1e3, n / t / 1e6);
+		g_free(options);
+		g_free(name);
+		g_free(signals);
+	}
+	emulator_stop(emulator);
+}
+
+gint main(int argc, gchar *argv[])
+{
+	gint fd = g_file_open_tmp("oblsc-bench-XXXXXX.rc", &config_file,
+				  NULL);
+
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create a temporary file\n");
+		return 1;
+	}
+	close(fd);
+
+	bench_decode();
+	bench_encode();
+	bench_uart();
+	bench_trigger();
+	bench_device();
+
+	unlink(config_file);
+	g_free(config_file);
+	return 0;
+}
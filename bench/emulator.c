@@ -0,0 +1,176 @@
+/* -*- linux-c -*-
+ *
+ * SUMP device emulated on a pseudo terminal
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include "emulator.h"
+#include "sump.h"
+#include "state.h"
+
+#define CMD_RUN 0x01
+#define CMD_ID 0x02
+#define CMD_SET_READ_AND_DELAY_COUNT 0x81
+#define CMD_SET_FLAGS 0x82
+
+struct emulator {
+	gchar *device;
+	gint terminal; /* Keeps the terminal open between captures */
+	pid_t child;
+};
+
+static gboolean read_all(gint fd, guint8 *data, gsize size)
+{
+	while (size > 0) {
+		ssize_t r = read(fd, data, size);
+
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return FALSE;
+		size -= r;
+		data += r;
+	}
+	return TRUE;
+}
+
+static gboolean write_all(gint fd, const guint8 *data, gsize size)
+{
+	while (size > 0) {
+		ssize_t r = write(fd, data, size);
+
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return FALSE;
+		size -= r;
+		data += r;
+	}
+	return TRUE;
+}
+
+/* The most recent sample first, the highest channel group first */
+static gboolean send_samples(gint fd, guint32 read_count, guint32 flags)
+{
+	gint n = (read_count + 1) * 4;
+	guint8 *buffer = g_malloc(n * 4);
+	gint size = 0;
+	gboolean ok;
+
+	for (gint t = n - 1; t >= 0; t--)
+		for (gint g = 3; g >= 0; g--)
+			if (!(flags & (SUMP_FLAG_CHANNEL_GROUP_0_DISABLED << g)))
+				buffer[size++] = (t >> (8 * g)) & 0xFF;
+	ok = write_all(fd, buffer, size);
+	g_free(buffer);
+	return ok;
+}
+
+static void serve(gint fd)
+{
+	guint32 read_count = MEMORY_SIZE / 4 - 1;
+	guint32 flags = 0;
+	guint8 command;
+	guint8 a[4];
+
+	while (read_all(fd, &command, 1)) {
+		/* Long commands have a 32 bit argument */
+		if (command & 0x80) {
+			if (!read_all(fd, a, sizeof(a)))
+				return;
+			if (command == CMD_SET_READ_AND_DELAY_COUNT)
+				read_count = a[0] | (a[1] << 8);
+			else if (command == CMD_SET_FLAGS)
+				flags = a[0] | (a[1] << 8) | (a[2] << 16)
+					| ((guint32)a[3] << 24);
+		} else if (command == CMD_ID) {
+			if (!write_all(fd, (guint8 *)"1ALS", 4))
+				return;
+		} else if (command == CMD_RUN) {
+			if (!send_samples(fd, read_count, flags))
+				return;
+		}
+	}
+}
+
+struct emulator *emulator_start(void)
+{
+	struct emulator *r = g_malloc0(sizeof(*r));
+	struct termios t;
+	gint master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	r->terminal = -1;
+	if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+		perror("Failed to create a pseudo terminal");
+		goto error;
+	}
+	r->device = g_strdup(ptsname(master));
+	r->terminal = open(r->device, O_RDWR | O_NOCTTY);
+	if (r->terminal == -1) {
+		perror(r->device);
+		goto error;
+	}
+	/* Nothing may be translated or echoed on the way */
+	tcgetattr(r->terminal, &t);
+	cfmakeraw(&t);
+	tcsetattr(r->terminal, TCSANOW, &t);
+
+	r->child = fork();
+	if (r->child == -1) {
+		perror("fork");
+		goto error;
+	}
+	if (r->child == 0) {
+		close(r->terminal);
+		serve(master);
+		_exit(0);
+	}
+	close(master);
+	return r;
+error:
+	if (master != -1)
+		close(master);
+	emulator_stop(r);
+	return NULL;
+}
+
+gchar *emulator_device(struct emulator *emulator)
+{
+	return emulator->device;
+}
+
+void emulator_stop(struct emulator *emulator)
+{
+	if (emulator->child > 0) {
+		kill(emulator->child, SIGTERM);
+		waitpid(emulator->child, NULL, 0);
+	}
+	if (emulator->terminal != -1)
+		close(emulator->terminal);
+	g_free(emulator->device);
+	g_free(emulator);
+}
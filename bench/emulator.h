@@ -0,0 +1,43 @@
+/* -*- linux-c -*-
+ *
+ * SUMP device emulated on a pseudo terminal
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _EMULATOR_H_
+#define _EMULATOR_H_
+
+#include <glib.h>
+
+struct emulator;
+
+/*
+ * Start a child process answering SUMP commands on a pseudo terminal
+ * until emulator_stop() is called. Channel c of the samples it sends
+ * toggles every 2^c samples. Return NULL on error.
+ */
+struct emulator *emulator_start(void);
+
+/* The name of the terminal to open as the device */
+gchar *emulator_device(struct emulator *emulator);
+
+void emulator_stop(struct emulator *emulator);
+
+#endif /* _EMULATOR_H_ */
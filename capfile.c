@@ -0,0 +1,107 @@
+/* -*- linux-c -*-
+ *
+ * Native capture files
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "capfile.h"
+#include "output.h"
+
+gboolean capfile_save(struct state *state, struct capture *capture)
+{
+	struct capfile_header header;
+	struct output *out;
+	guint32 chunk[4096];
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPFILE_MAGIC, sizeof(header.magic));
+	header.version = CAPFILE_VERSION;
+	header.channels_in_use = state->channels_in_use;
+	header.noof_samples = capture->noof_samples;
+	header.trigger = capture->trigger;
+	header.sample_rate = state->sample_rate;
+
+	out = output_open(state->outfile, state->compress,
+			  sizeof(header) + capture->noof_samples
+			  * sizeof(guint32));
+	if (out == NULL)
+		return FALSE;
+
+	output_write(out, &header, sizeof(header));
+	for (gint i = 0; i < capture->noof_samples; i += G_N_ELEMENTS(chunk)) {
+		gint n = MIN(G_N_ELEMENTS(chunk), capture->noof_samples - i);
+
+		for (gint j = 0; j < n; j++)
+			chunk[j] = capture->samples[i + j];
+		output_write(out, chunk, n * sizeof(*chunk));
+	}
+	return output_close(out);
+}
+
+struct capture *capfile_load(struct state *state, gchar *filename,
+			     glong *sample_rate)
+{
+	struct capfile_header header;
+	sample_t *samples = NULL;
+	guint32 chunk[4096];
+	FILE *f;
+
+	f = fopen(filename, "rb");
+	if (f == NULL) {
+		perror(filename);
+		return NULL;
+	}
+
+	if (fread(&header, sizeof(header), 1, f) != 1
+	    || memcmp(header.magic, CAPFILE_MAGIC, sizeof(header.magic)) != 0
+	    || header.version != CAPFILE_VERSION) {
+		fprintf(stderr, "%s: Not an oblsc capture file\n", filename);
+		goto error;
+	}
+	if (state->channels_in_use & ~header.channels_in_use) {
+		fprintf(stderr, "%s: The channels 0x%08x used by the signals "
+			"were not captured\n", filename,
+			state->channels_in_use & ~header.channels_in_use);
+		goto error;
+	}
+
+	samples = g_malloc(MAX(header.noof_samples, 1) * sizeof(*samples));
+	for (guint32 i = 0; i < header.noof_samples;
+	     i += G_N_ELEMENTS(chunk)) {
+		gint n = MIN(G_N_ELEMENTS(chunk), header.noof_samples - i);
+
+		if (fread(chunk, sizeof(*chunk), n, f) != n) {
+			fprintf(stderr, "%s: File is truncated\n", filename);
+			goto error;
+		}
+		for (gint j = 0; j < n; j++)
+			samples[i + j] = chunk[j];
+	}
+	fclose(f);
+
+	*sample_rate = header.sample_rate;
+	return capture_new_from_samples(state, samples, header.noof_samples,
+					header.trigger);
+error:
+	g_free(samples);
+	fclose(f);
+	return NULL;
+}
@@ -0,0 +1,62 @@
+/* -*- linux-c -*-
+ *
+ * Native capture files
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _CAPFILE_H_
+#define _CAPFILE_H_
+
+#include "state.h"
+#include "capture.h"
+
+/*
+ * File layout, all fields in native byte order:
+ *
+ *   struct capfile_header
+ *   guint32 samples[noof_samples], oldest first
+ *
+ * Only the physical channels are stored, bit n of a sample is channel
+ * n. The signals are not stored, they are given when the file is
+ * loaded.
+ */
+
+#define CAPFILE_MAGIC "OBLSCCAP"
+#define CAPFILE_VERSION 1
+
+struct capfile_header {
+	gchar magic[8];
+	guint32 version;
+	guint32 channels_in_use;
+	guint32 noof_samples;
+	gint32 trigger;
+	gdouble sample_rate;
+};
+
+gboolean capfile_save(struct state *state, struct capture *capture);
+
+/*
+ * Load a capture using the signals of the state, the sample rate of
+ * the file is returned in sample_rate. Return NULL on error.
+ */
+struct capture *capfile_load(struct state *state, gchar *filename,
+			     glong *sample_rate);
+
+#endif /* _CAPFILE_H_ */
@@ -0,0 +1,249 @@
+/* -*- linux-c -*-
+ *
+ * Unpacked capture and its edge index
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "capture.h"
+#include "virtual.h"
+#include "deglitch.h"
+
+static sample_t unpack_sample(guint32 channels_in_use, guint8 *samples)
+{
+	sample_t v = 0;
+
+	if (channels_in_use & 0x000000FF)
+		v |= *samples--;
+	if (channels_in_use & 0x0000FF00)
+		v |= ((sample_t)*samples-- << 8);
+	if (channels_in_use & 0x00FF0000)
+		v |= ((sample_t)*samples-- << 16);
+	if (channels_in_use & 0xFF000000)
+		v |= ((sample_t)*samples-- << 24);
+	return v;
+}
+
+struct capture *capture_new(struct state *state, guint8 *buffer)
+{
+	gint noof_groups = state_noof_channel_groups_in_use(state);
+	gint n = state_buffer_capacity(state);
+	sample_t *samples = g_malloc(n * sizeof(*samples));
+
+	/* The hardware sends the most recent sample first */
+	for (gint i = 0; i < n; i++)
+		samples[i] = unpack_sample(state->channels_in_use,
+					   buffer + (n - i) * noof_groups - 1);
+
+	return capture_new_from_samples(state, samples, n,
+					state->trigger_holdoff);
+}
+
+struct capture *capture_new_from_samples(struct state *state,
+					 sample_t *samples,
+					 gint noof_samples, gint trigger)
+{
+	struct capture *c = g_malloc0(sizeof(*c));
+
+	c->state = state;
+	c->noof_samples = noof_samples;
+	c->trigger = trigger;
+	c->samples = samples;
+
+	/* Virtual channels are computed from the filtered channels */
+	deglitch_channels(c, 0, NOOF_PHYSICAL_CHANNELS);
+	virtual_compute(c);
+	deglitch_channels(c, NOOF_PHYSICAL_CHANNELS, CAPTURE_NOOF_CHANNELS);
+	capture_index(c);
+	return c;
+}
+
+static void free_index(struct capture *capture)
+{
+	g_free(capture->changes);
+	capture->changes = NULL;
+	capture->noof_changes = 0;
+	for (gint i = 0; i < CAPTURE_NOOF_CHANNELS; i++) {
+		g_free(capture->edges[i]);
+		capture->edges[i] = NULL;
+		capture->noof_edges[i] = 0;
+	}
+}
+
+void capture_free(struct capture *capture)
+{
+	free_index(capture);
+	g_free(capture->samples);
+	g_free(capture);
+}
+
+void capture_index(struct capture *capture)
+{
+	gint n = capture->noof_samples;
+	sample_t in_use = capture->state->channels_in_use
+		| ((((sample_t)1 << capture->state->noof_virtual_channels) - 1)
+		   << NOOF_PHYSICAL_CHANNELS);
+	sample_t *diff;
+	gint fill[CAPTURE_NOOF_CHANNELS];
+
+	free_index(capture);
+	if (n < 2)
+		return;
+
+	/*
+	 * First a flat pass producing the change word for every sample,
+	 * this is a straight loop over arrays which the compiler can
+	 * vectorize. The rest of the work is proportional to the number
+	 * of changes, not the number of samples.
+	 */
+	diff = g_malloc(n * sizeof(*diff));
+	diff[0] = 0;
+	for (gint i = 1; i < n; i++)
+		diff[i] = (capture->samples[i] ^ capture->samples[i - 1])
+			& in_use;
+
+	for (gint i = 1; i < n; i++)
+		if (diff[i])
+			capture->noof_changes++;
+	capture->changes = g_malloc(capture->noof_changes
+				    * sizeof(*capture->changes));
+
+	for (gint i = 1, c = 0; i < n; i++) {
+		if (!diff[i])
+			continue;
+		capture->changes[c].sample = i;
+		capture->changes[c++].diff = diff[i];
+		for (sample_t d = diff[i]; d; d &= d - 1)
+			capture->noof_edges[__builtin_ctzll(d)]++;
+	}
+	g_free(diff);
+
+	for (gint ch = 0; ch < CAPTURE_NOOF_CHANNELS; ch++) {
+		fill[ch] = 0;
+		if (capture->noof_edges[ch])
+			capture->edges[ch] = g_malloc(
+				capture->noof_edges[ch]
+				* sizeof(*capture->edges[ch]));
+	}
+	for (gint c = 0; c < capture->noof_changes; c++)
+		for (sample_t d = capture->changes[c].diff; d; d &= d - 1) {
+			gint ch = __builtin_ctzll(d);
+
+			capture->edges[ch][fill[ch]++] =
+				capture->changes[c].sample;
+		}
+}
+
+void capture_crop(struct capture *capture, gint start, gint end)
+{
+	start = CLAMP(start, 0, capture->noof_samples);
+	end = CLAMP(end, start, capture->noof_samples);
+
+	memmove(capture->samples, capture->samples + start,
+		(end - start) * sizeof(*capture->samples));
+	capture->noof_samples = end - start;
+	capture->trigger -= start;
+	capture_index(capture);
+}
+
+guint64 *capture_bitplane(struct capture *capture, gint channel)
+{
+	return capture_bitplane_range(capture, channel, 0,
+				      capture->noof_samples);
+}
+
+guint64 *capture_bitplane_range(struct capture *capture, gint channel,
+				gint start, gint n)
+{
+	gint words = (n + 63) / 64;
+	guint64 *plane = g_malloc0(MAX(words, 1) * sizeof(*plane));
+
+	for (gint w = 0; w < words; w++) {
+		sample_t *samples = capture->samples + start + w * 64;
+		gint count = MIN(64, n - w * 64);
+		guint64 v = 0;
+
+		for (gint b = 0; b < count; b++)
+			v |= (guint64)((samples[b] >> channel) & 1) << b;
+		plane[w] = v;
+	}
+	return plane;
+}
+
+void capture_bitplane_shift_or(guint64 *r, const guint64 *p, gint words,
+			       gint k)
+{
+	gint q = ABS(k) / 64;
+	gint b = ABS(k) % 64;
+
+	for (gint w = 0; w < words; w++) {
+		gint from = k > 0 ? w - q : w + q;
+		gint next = k > 0 ? from - 1 : from + 1;
+		guint64 v = 0;
+
+		if (from >= 0 && from < words)
+			v = k > 0 ? p[from] << b : p[from] >> b;
+		if (b && next >= 0 && next < words)
+			v |= k > 0 ? p[next] >> (64 - b) : p[next] << (64 - b);
+		r[w] |= v;
+	}
+}
+
+gint capture_bitplane_find(const guint64 *plane, gint n, gint from,
+			   gboolean set)
+{
+	while (from < n) {
+		guint64 w = plane[from / 64];
+
+		if (!set)
+			w = ~w;
+		w &= ~(guint64)0 << (from % 64);
+		if (w)
+			return MIN(from - from % 64 + __builtin_ctzll(w), n);
+		from += 64 - from % 64;
+	}
+	return n;
+}
+
+guint32 capture_signal_value(struct signal_def *signal, sample_t sample)
+{
+	guint32 v = 0;
+
+	for (gint bit = 0; bit < signal->noof_bits; bit++)
+		if (sample & ((sample_t)1 << signal->channels[bit]))
+			v |= (1 << bit);
+	return v;
+}
+
+gint capture_find_edge(struct capture *capture, gint channel, gint sample)
+{
+	gint *edges = capture->edges[channel];
+	gint lo = 0, hi = capture->noof_edges[channel];
+
+	while (lo < hi) {
+		gint mid = lo + (hi - lo) / 2;
+
+		if (edges[mid] < sample)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
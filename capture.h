@@ -0,0 +1,116 @@
+/* -*- linux-c -*-
+ *
+ * Unpacked capture and its edge index
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <glib.h>
+#include "state.h"
+
+/* The physical channels followed by the virtual channels */
+#define CAPTURE_NOOF_CHANNELS (NOOF_PHYSICAL_CHANNELS + MAX_VIRTUAL_CHANNELS)
+
+/* One unpacked sample, bit n is the value of channel n */
+typedef guint64 sample_t;
+
+/* A sample at which at least one channel in use changes value */
+struct capture_change {
+	gint sample;
+	sample_t diff; /* Bit-vector of the channels which changed */
+};
+
+struct capture {
+	struct state *state;
+	gint noof_samples;
+	sample_t *samples; /* In time order, oldest first */
+	gint trigger; /* Sample index of the trigger point */
+
+	/* Edge index, built by capture_index() */
+	gint noof_changes;
+	struct capture_change *changes;
+	/* Sorted sample indices at which each channel changes value */
+	gint noof_edges[CAPTURE_NOOF_CHANNELS];
+	gint *edges[CAPTURE_NOOF_CHANNELS];
+};
+
+/*
+ * Unpack the raw buffer as read from the hardware and index it. The
+ * buffer is not referenced by the returned capture.
+ */
+struct capture *capture_new(struct state *state, guint8 *buffer);
+
+/*
+ * Make a capture of unpacked physical channels, the physical channels
+ * of each sample are in the low bits. The capture takes over the
+ * samples, which must be allocated with g_malloc.
+ */
+struct capture *capture_new_from_samples(struct state *state,
+					 sample_t *samples,
+					 gint noof_samples, gint trigger);
+
+void capture_free(struct capture *capture);
+
+/* (Re)build the edge index, must be called if the samples change */
+void capture_index(struct capture *capture);
+
+/*
+ * Keep only the samples in [start, end), clamped to the capture. The
+ * trigger point follows the samples and the index is rebuilt.
+ */
+void capture_crop(struct capture *capture, gint start, gint end);
+
+/*
+ * Return the values of channel packed 64 samples to a word, sample i
+ * is bit i % 64 of word i / 64. Bits past the last sample are zero.
+ * The caller frees the result.
+ */
+guint64 *capture_bitplane(struct capture *capture, gint channel);
+
+/* As capture_bitplane() for the n samples from start */
+guint64 *capture_bitplane_range(struct capture *capture, gint channel,
+				gint start, gint n);
+
+/*
+ * r |= p with the samples moved k samples later (earlier if k is
+ * negative). Both planes hold words words.
+ */
+void capture_bitplane_shift_or(guint64 *r, const guint64 *p, gint words,
+			       gint k);
+
+/*
+ * Return the first sample at or after from which is set (or clear if
+ * set is FALSE) in the plane of n samples, n if there is none.
+ */
+gint capture_bitplane_find(const guint64 *plane, gint n, gint from,
+			   gboolean set);
+
+/* Extract the value of signal from a sample */
+guint32 capture_signal_value(struct signal_def *signal, sample_t sample);
+
+/*
+ * Return the position in the edge list of channel of the first edge
+ * at or after sample.
+ */
+gint capture_find_edge(struct capture *capture, gint channel, gint sample);
+
+#endif /* _CAPTURE_H_ */
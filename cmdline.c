@@ -21,6 +21,7 @@
  * 02110-1301, USA.
  */
 #include "cmdline.h"
+#include "virtual.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +29,12 @@
 #include <errno.h>
 #include <unistd.h>
 
+/* FST output is only there when built with the writer from Gtkwave */
+#ifdef HAVE_FST
+#define OUTPUT_FORMATS "vcd/fst/sr/npy/cap"
+#else
+#define OUTPUT_FORMATS "vcd/sr/npy/cap"
+#endif
 
 struct param {
 	gchar *value;
@@ -44,16 +51,42 @@ struct cmd_line {
 
 	/* clock */
 	struct param sample_rate;
+	gboolean auto_rate;
 	struct param external_clock;
 	struct param external_invert;
 
 	/* capture */
 	struct param filter;
 	struct param trigger_split;
+	struct param soft_window;
+
+	/* output */
+	struct param write_policy;
+	struct param archive;
 
 	gchar *outfile;
+	gchar *format;
+	gboolean compress;
+	gboolean pyramid;
+	gboolean stats;
+	gchar *stats_json;
+	gchar **decoders;
+	gchar *decode_outfile;
+	gchar **input_files;
+	gchar *compare_file;
+	gchar **compare_masks;
+	gint tolerance;
+	gboolean jitter;
+	gchar *repeat;
+	gchar *jitter_edges;
+	gboolean live;
+	gboolean simulate_trigger;
+	gboolean plan;
+	gchar **queries;
 	gchar **signals;
+	gchar **deglitch;
 	gchar *trigger;
+	gchar *soft_trigger;
 
 };
 
@@ -100,6 +133,22 @@ static void handle_command_line(struct cmd_line *cl, int argc, gchar *argv[])
 		  .description = "The number of samples to keep before the" \
 		                 " trigger-point",
 		  .arg_description = "<percent>%/<number-of-samples>/time"},
+		{ .long_name = "soft-trigger",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->soft_trigger,
+		  .description = "Set a trigger condition evaluated in"
+		                 " software on the captured data",
+		  .arg_description = "<trigger-spec>"},
+		{ .long_name = "soft-window",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->soft_window,
+		  .description = "The samples to keep before and after the"
+		                 " software trigger-point",
+		  .arg_description = "<before>,<after>"},
 		{ .long_name = "sample-rate",
 		  .short_name = 'S',
 		  .flags = 0,
@@ -107,6 +156,13 @@ static void handle_command_line(struct cmd_line *cl, int argc, gchar *argv[])
 		  .arg_data = &cl->sample_rate,
 		  .description = "The sample rate",
 		  .arg_description = "<Hz>" },
+		{ .long_name = "auto-rate",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->auto_rate,
+		  .description = "Choose the sample rate from probe"
+		                 " captures" },
 		{ .long_name = "filter",
 		  .short_name = 'f',
 		  .flags = 0,
@@ -135,6 +191,154 @@ static void handle_command_line(struct cmd_line *cl, int argc, gchar *argv[])
 		  .arg_data = &cl->outfile,
 		  .description = "Output filename",
 		  .arg_description = "<filename>" },
+		{ .long_name = "format",
+		  .short_name = 'F',
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->format,
+		  .description = "Output format, by default given by the"
+		                 " suffix of the output filename",
+		  .arg_description = OUTPUT_FORMATS },
+		{ .long_name = "compress",
+		  .short_name = 'z',
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->compress,
+		  .description = "Gzip compress the output, implied by a"
+		                 " .gz suffix on the output filename" },
+		{ .long_name = "write-policy",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->write_policy,
+		  .description = "How output files are written",
+		  .arg_description = "buffered/direct/sync" },
+		{ .long_name = "pyramid",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->pyramid,
+		  .description = "Also write a multi-resolution summary to"
+		                 " <filename>.pyr" },
+		{ .long_name = "stats",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->stats,
+		  .description = "Write signal statistics as JSON instead"
+		                 " of the samples" },
+		{ .long_name = "stats-json",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_FILENAME,
+		  .arg_data = &cl->stats_json,
+		  .description = "Append the time spent in each phase of"
+		                 " every capture as JSON to a file",
+		  .arg_description = "<filename>" },
+		{ .long_name = "decode",
+		  .short_name = 'd',
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING_ARRAY,
+		  .arg_data = &cl->decoders,
+		  .description = "Decode a protocol",
+		  .arg_description = "<protocol>:<key>=<value>,..."},
+		{ .long_name = "decode-output",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_FILENAME,
+		  .arg_data = &cl->decode_outfile,
+		  .description = "Decoded data filename",
+		  .arg_description = "<filename>" },
+		{ .long_name = "archive",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_FILENAME,
+		  .arg_data = &cl->archive,
+		  .description = "Also store the capture in an archive"
+		                 " directory",
+		  .arg_description = "<directory>" },
+		{ .long_name = "query",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING_ARRAY,
+		  .arg_data = &cl->queries,
+		  .description = "List the archived captures matching a"
+		                 " predicate instead of capturing",
+		  .arg_description = "<signal>=<value>[@<from>..<to>]"},
+		{ .long_name = "input",
+		  .short_name = 'I',
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_FILENAME_ARRAY,
+		  .arg_data = &cl->input_files,
+		  .description = "Read the samples from a capture file"
+		                 " instead of the device",
+		  .arg_description = "<filename>" },
+		{ .long_name = "compare",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_FILENAME,
+		  .arg_data = &cl->compare_file,
+		  .description = "Compare the capture against a golden"
+		                 " capture file",
+		  .arg_description = "<filename>" },
+		{ .long_name = "compare-mask",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING_ARRAY,
+		  .arg_data = &cl->compare_masks,
+		  .description = "Only compare the given bits of a signal",
+		  .arg_description = "<name>=<mask>"},
+		{ .long_name = "tolerance",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_INT,
+		  .arg_data = &cl->tolerance,
+		  .description = "Number of samples an edge may move"
+		                 " when comparing",
+		  .arg_description = "<samples>"},
+		{ .long_name = "jitter",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->jitter,
+		  .description = "Write the edge jitter over several"
+		                 " captures as JSON instead of the samples" },
+		{ .long_name = "repeat",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->repeat,
+		  .description = "Number of captures analysed by --jitter",
+		  .arg_description = "<captures>"},
+		{ .long_name = "jitter-edges",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING,
+		  .arg_data = &cl->jitter_edges,
+		  .description = "Number of edges on each side of the"
+		                 " trigger analysed by --jitter",
+		  .arg_description = "<edges>"},
+		{ .long_name = "live",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->live,
+		  .description = "Capture continuously and show the signals"
+		                 " in the terminal" },
+		{ .long_name = "simulate-trigger",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->simulate_trigger,
+		  .description = "Report where the hardware trigger fires"
+		                 " in the input file or a synthetic stream" },
+		{ .long_name = "plan",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_NONE,
+		  .arg_data = &cl->plan,
+		  .description = "Print what the capture would cost without"
+		                 " capturing" },
 		{ .long_name = "signal",
 		  .short_name = 's',
 		  .flags = 0,
@@ -142,6 +346,14 @@ static void handle_command_line(struct cmd_line *cl, int argc, gchar *argv[])
 		  .arg_data = &cl->signals,
 		  .description = "Define an input signal",
 		  .arg_description = "<name>:<chlist>"},
+		{ .long_name = "deglitch",
+		  .short_name = 0,
+		  .flags = 0,
+		  .arg = G_OPTION_ARG_STRING_ARRAY,
+		  .arg_data = &cl->deglitch,
+		  .description = "Remove pulses of a signal shorter than"
+		                 " a minimum width",
+		  .arg_description = "<name>:<width>"},
 		{ NULL }
 	};
 
@@ -249,6 +461,24 @@ static void parse_sample_rate(struct param *value, glong *sample_rate)
 
 }
 
+/* A positive count, or the default if the option was not given */
+static gint parse_count(gchar *desc, gchar *text, gint fallback)
+{
+	gchar *tail;
+	glong v;
+
+	if (text == NULL)
+		return fallback;
+	v = strtol(text, &tail, 10);
+	if (text == tail || *tail != 0 || v < 1 || v > G_MAXINT) {
+		fprintf(stderr,
+			"The number of %s \"%s\" is not a positive integer\n",
+			desc, text);
+		exit(1);
+	}
+	return v;
+}
+
 static void parse_boolean(gchar *desc, struct param *value, gboolean *flag)
 {
 	if (*value->value == '1' ||
@@ -267,25 +497,103 @@ static void parse_boolean(gchar *desc, struct param *value, gboolean *flag)
 			value->value);
 }
 
-static GList *parse_channel_list(gchar *channels)
+static void parse_format(struct cmd_line *cl, struct state *state)
+{
+	gchar *format = cl->format;
+
+	if (format == NULL) {
+		if (cl->outfile != NULL && g_str_has_suffix(cl->outfile, ".fst"))
+			format = "fst";
+		else if (cl->outfile != NULL
+			 && g_str_has_suffix(cl->outfile, ".sr"))
+			format = "sr";
+		else if (cl->outfile != NULL
+			 && g_str_has_suffix(cl->outfile, ".npy"))
+			format = "npy";
+		else if (cl->outfile != NULL
+			 && g_str_has_suffix(cl->outfile, ".cap"))
+			format = "cap";
+		else
+			format = "vcd";
+	}
+
+	if (strcasecmp(format, "vcd") == 0)
+		state->format = FORMAT_VCD;
+	else if (strcasecmp(format, "fst") == 0) {
+#ifdef HAVE_FST
+		state->format = FORMAT_FST;
+#else
+		fprintf(stderr, "FST output is not available, oblsc was "
+			"built without the FST writer\n");
+		exit(1);
+#endif
+	} else if (strcasecmp(format, "sr") == 0)
+		state->format = FORMAT_SIGROK;
+	else if (strcasecmp(format, "npy") == 0)
+		state->format = FORMAT_NPY;
+	else if (strcasecmp(format, "cap") == 0)
+		state->format = FORMAT_CAPTURE;
+	else {
+		fprintf(stderr, "Unknown output format \"%s\"\n", format);
+		exit(1);
+	}
+
+	if (state->compress && state->format != FORMAT_VCD) {
+		fprintf(stderr,
+			"Compression is only supported for VCD output\n");
+		exit(1);
+	}
+}
+
+static void parse_write_policy(struct param *value,
+			       enum output_policy *policy)
 {
+	if (strcasecmp(value->value, "buffered") == 0)
+		*policy = OUTPUT_POLICY_BUFFERED;
+	else if (strcasecmp(value->value, "direct") == 0)
+		*policy = OUTPUT_POLICY_DIRECT;
+	else if (strcasecmp(value->value, "sync") == 0)
+		*policy = OUTPUT_POLICY_SYNC;
+	else {
+		fprintf(stderr,
+			"Unknown write policy \"%s\" as specified %s\n",
+			value->value,
+			value->where == CMDLINE ? "on the command line" :
+			"in the configuration file");
+		exit(1);
+	}
+}
+
+/*
+ * Parse a channel list into the array of gints r, a channel or span
+ * prefixed by '~' is inverted through virtual channels.
+ */
+static void parse_channel_list(struct state *state, gchar *channels,
+			       GArray *r)
+{
+	gboolean invert = *channels == '~';
+	gchar *first = invert ? channels + 1 : channels;
 	gchar *tail;
-	long channel = strtol(channels, &tail, 0);
+	long channel = strtol(first, &tail, 0);
 	long channel2;
 	gchar *tail2;
-	GList *r = NULL;
-	int i;
+	gint i;
 
-	if (tail == channels) {
+	if (tail == first) {
 		fprintf(stderr, "Expected channel number at '%s'\n",
 			channels);
 		exit(1);
 	}
-	if (*tail == 0)
-		return g_list_prepend(NULL, GINT_TO_POINTER(channel));
-	if (*tail == ',')
-		return g_list_prepend(parse_channel_list(tail + 1),
-				      GINT_TO_POINTER(channel));
+	if (*tail == 0 || *tail == ',') {
+		if (invert)
+			channel = state_add_virtual_channel(
+				state, VIRTUAL_NOT, channel, -1);
+		i = channel;
+		g_array_append_val(r, i);
+		if (*tail == ',')
+			parse_channel_list(state, tail + 1, r);
+		return;
+	}
 	if (*tail != '-') {
 		fprintf(stderr, "Unexpected separator in channel list '%s'\n",
 			channels);
@@ -302,7 +610,10 @@ static GList *parse_channel_list(gchar *channels)
 
 	i = channel;
 	while (TRUE) {
-		r = g_list_append(r, GINT_TO_POINTER(i));
+		gint c = invert ? state_add_virtual_channel(
+			state, VIRTUAL_NOT, i, -1) : i;
+
+		g_array_append_val(r, c);
 		if (i == channel2)
 			break;
 		if (channel < channel2)
@@ -310,10 +621,12 @@ static GList *parse_channel_list(gchar *channels)
 		else
 			i--;
 	}
-	if (*tail2 == ',')
-		return g_list_concat(r, parse_channel_list(tail2 + 1));
+	if (*tail2 == ',') {
+		parse_channel_list(state, tail2 + 1, r);
+		return;
+	}
 	if (*tail2 == 0)
-		return r;
+		return;
 	fprintf(stderr,
 		"Expected end of channel list following '%s'\n",
 		tail);
@@ -330,8 +643,20 @@ static void parse_signals(gchar **signals, struct state *state)
 	}
 	for (int i = 0; signals[i] != NULL; i++) {
 		gchar *tmp = g_strdup(signals[i]);
-		gchar *name = strtok(tmp, ":");
-		gchar *channels = strtok(NULL, ":");
+		gchar *expr = strpbrk(tmp, ":=");
+		gchar *name;
+		gchar *channels;
+		GArray *list;
+
+		if (expr != NULL && *expr == '=') {
+			/* A virtual signal defined by an expression */
+			*expr = 0;
+			virtual_add_signal(state, tmp, expr + 1);
+			g_free(tmp);
+			continue;
+		}
+		name = strtok(tmp, ":");
+		channels = strtok(NULL, ":");
 
 		if (channels == NULL) {
 			fprintf(stderr,
@@ -339,27 +664,36 @@ static void parse_signals(gchar **signals, struct state *state)
 				signals[i]);
 			exit(1);
 		}
-		state_add_signal(state, name, parse_channel_list(channels));
+		list = g_array_new(FALSE, FALSE, sizeof(gint));
+		parse_channel_list(state, channels, list);
+		state_add_signal(state, name, (gint *)list->data, list->len);
+		g_array_free(list, TRUE);
 		g_free(tmp);
 	}
 }
 
-/* Trigger split must be called last when the state is populated */
-static void parse_trigger_split(struct param *value, struct state *state)
+/*
+ * Parse a number of samples given as a percentage of the buffer, a
+ * plain number of samples or a time. Must be called when the state is
+ * populated.
+ */
+static gint parse_samples(gchar *desc, gchar *text, struct param *value,
+			  struct state *state)
 {
 	double v;
 	char *tail;
 	gint samples = -1;
 	gint buffer_size = state_buffer_capacity(state);
 
-	v = strtod(value->value, &tail);
-	if (value->value == tail) {
+	v = strtod(text, &tail);
+	if (text == tail) {
 		fprintf(stderr,
 			"Cannot parse \"%s\" as specified %s "
-			"as a valid trigger split.\n",
-			value->value,
+			"as a valid %s.\n",
+			text,
 			value->where == CMDLINE ? "on the command line" :
-			"in the configuration file");
+			"in the configuration file",
+			desc);
 		exit(1);
 	}
 	if (*tail == '%') {
@@ -367,7 +701,7 @@ static void parse_trigger_split(struct param *value, struct state *state)
 	} else if (*tail == 0) {
 		samples = v;
 	} else if (strcasecmp(tail, "s") == 0) {
-		samples = state->sample_rate;
+		samples = state->sample_rate * v;
 	} else if (strcasecmp(tail, "ms") == 0) {
 		samples = state->sample_rate * v * 0.001;
 	} else if (strcasecmp(tail, "us") == 0) {
@@ -379,14 +713,38 @@ static void parse_trigger_split(struct param *value, struct state *state)
 	} else {
 		fprintf(stderr,
 			"Cannot parse \"%s\" as specified %s as a "
-			"valid trigger split. "
+			"valid %s. "
 			"The suffix \"%s\" is not supported\n",
-			value->value,
+			text,
 			value->where == CMDLINE ? "on the command line" :
 			"in the configuration file",
+			desc,
 			tail);
 		exit(1);
 	}
+	/*
+	 * The rate is chosen by the probes or read from the input file
+	 * later, so the times would be converted with the wrong rate
+	 */
+	if (*tail != '%' && *tail != 0
+	    && (state->auto_rate || state->input_files != NULL)) {
+		fprintf(stderr,
+			"The %s \"%s\" cannot be given as a time with %s, "
+			"give it in samples or percent\n",
+			desc, text,
+			state->auto_rate ? "--auto-rate" : "--input");
+		exit(1);
+	}
+	return samples;
+}
+
+/* Trigger split must be called last when the state is populated */
+static void parse_trigger_split(struct param *value, struct state *state)
+{
+	gint samples = parse_samples("trigger split", value->value, value,
+				     state);
+	gint buffer_size = state_buffer_capacity(state);
+
 	/* Do sanity check */
 	if (samples > buffer_size) {
 		fprintf(stderr,
@@ -398,6 +756,85 @@ static void parse_trigger_split(struct param *value, struct state *state)
 	state->trigger_holdoff = samples;
 }
 
+/* Without a window the whole capture is kept */
+static void parse_soft_window(struct param *value, struct state *state)
+{
+	gchar **parts;
+
+	state->soft_before = G_MAXINT;
+	state->soft_after = G_MAXINT;
+	if (value->value == NULL)
+		return;
+
+	parts = g_strsplit(value->value, ",", 2);
+	if (parts[0] == NULL || parts[1] == NULL) {
+		fprintf(stderr,
+			"Expected <before>,<after> in software trigger "
+			"window \"%s\"\n",
+			value->value);
+		goto error;
+	}
+	state->soft_before = parse_samples("software trigger window",
+					   parts[0], value, state);
+	state->soft_after = parse_samples("software trigger window",
+					  parts[1], value, state);
+	if (state->soft_before < 0 || state->soft_after < 0) {
+		fprintf(stderr,
+			"The software trigger window \"%s\" is negative\n",
+			value->value);
+		goto error;
+	}
+	g_strfreev(parts);
+	return;
+error:
+	g_strfreev(parts);
+	exit(1);
+}
+
+static void parse_deglitch(gchar **specs, struct state *state)
+{
+	memset(state->deglitch_width, 0, sizeof(state->deglitch_width));
+	for (gint i = 0; specs != NULL && specs[i] != NULL; i++) {
+		struct param value = { .value = specs[i], .where = CMDLINE };
+		gchar *width = strchr(specs[i], ':');
+		gchar *name;
+		struct signal_def *s;
+		gint samples;
+
+		if (width == NULL) {
+			fprintf(stderr,
+				"Expected <name>:<width> in glitch filter "
+				"\"%s\"\n", specs[i]);
+			exit(1);
+		}
+		name = g_strndup(specs[i], width - specs[i]);
+		s = state_lookup_signal(state, name);
+		if (s == NULL) {
+			fprintf(stderr,
+				"Signal %s used in glitch filter is not "
+				"defined\n", name);
+			exit(1);
+		}
+		g_free(name);
+
+		samples = parse_samples("minimum pulse width", width + 1,
+					&value, state);
+		if (samples < 1) {
+			fprintf(stderr,
+				"The minimum pulse width \"%s\" is less than "
+				"one sample\n", width + 1);
+			exit(1);
+		}
+		/* Channels shared by several signals get the widest */
+		for (gint bit = 0; bit < s->noof_bits; bit++) {
+			gint ch = s->channels[bit];
+
+			state->deglitch_width[ch] =
+				MAX(state->deglitch_width[ch], samples);
+		}
+	}
+}
+
 static void include_config_and_defaults(
 	struct cmd_line *cl, gchar *filename)
 {
@@ -421,6 +858,10 @@ static void include_config_and_defaults(
 		      &cl->external_invert);
 	lookup_option(f, "capture", "filter", "true", &cl->filter);
 	lookup_option(f, "capture", "split", "0%", &cl->trigger_split);
+	lookup_option(f, "capture", "soft-window", NULL, &cl->soft_window);
+	lookup_option(f, "output", "write-policy", "buffered",
+		      &cl->write_policy);
+	lookup_option(f, "output", "archive", NULL, &cl->archive);
 
 	g_key_file_free(f);
 }
@@ -428,20 +869,114 @@ static void include_config_and_defaults(
 static void setup_state(struct cmd_line *cl, struct state *state)
 {
 	state->signals = NULL;
+	state->signal_names = NULL;
 	state->channels_in_use = 0;
+	state->noof_virtual_channels = 0;
 	state->device = cl->device.value;
 	state->outfile = cl->outfile;
+	state->compress = cl->compress
+		|| (cl->outfile != NULL && g_str_has_suffix(cl->outfile, ".gz"));
 	state->noof_signals = 0;
 	state->trigger_spec = cl->trigger;
+	state->soft_trigger_spec = cl->soft_trigger;
+	parse_format(cl, state);
+	state->pyramid = cl->pyramid;
+	state->stats = cl->stats;
+	state->stats_json = cl->stats_json;
+	state->decoders = cl->decoders;
+	state->decode_outfile = cl->decode_outfile;
+	if (state->decoders != NULL && state->decode_outfile == NULL
+	    && state->outfile == NULL) {
+		fprintf(stderr,
+			"The decoded data and the capture cannot both be "
+			"written to stdout, use --output or --decode-output\n");
+		exit(1);
+	}
+	state->input_files = cl->input_files;
+	state->jitter = cl->jitter;
+	state->repeat = parse_count("captures", cl->repeat, 100);
+	state->jitter_edges = parse_count("edges", cl->jitter_edges, 4);
+	if (state->input_files != NULL && state->input_files[1] != NULL
+	    && !state->jitter) {
+		fprintf(stderr,
+			"Several input files can only be used with --jitter\n");
+		exit(1);
+	}
+	if (!state->jitter
+	    && (cl->repeat != NULL || cl->jitter_edges != NULL)) {
+		fprintf(stderr,
+			"--repeat and --jitter-edges can only be used with "
+			"--jitter\n");
+		exit(1);
+	}
+	state->live = cl->live;
+	/* An archive from the configuration file is just not used */
+	if (state->live && (state->input_files != NULL || state->jitter
+			    || cl->compare_file != NULL
+			    || state->outfile != NULL
+			    || state->decoders != NULL
+			    || cl->archive.where == CMDLINE)) {
+		fprintf(stderr,
+			"--live cannot be combined with input files, "
+			"--jitter, --compare, --output, --decode or "
+			"--archive\n");
+		exit(1);
+	}
+	state->simulate_trigger = cl->simulate_trigger;
+	if (state->simulate_trigger && (state->trigger_spec == NULL
+					|| state->jitter || state->live
+					|| cl->compare_file != NULL)) {
+		fprintf(stderr,
+			"--simulate-trigger needs a --trigger and cannot be "
+			"combined with --jitter, --live or --compare\n");
+		exit(1);
+	}
+	state->plan = cl->plan;
+	if (state->plan && (state->input_files != NULL || cl->auto_rate
+			    || state->jitter || state->live
+			    || state->simulate_trigger
+			    || cl->compare_file != NULL)) {
+		fprintf(stderr,
+			"--plan cannot be combined with input files, "
+			"--auto-rate, --jitter, --live, --compare or "
+			"--simulate-trigger\n");
+		exit(1);
+	}
+	state->compare_file = cl->compare_file;
+	state->compare_masks = cl->compare_masks;
+	state->compare_tolerance = cl->tolerance;
+	if (state->compare_tolerance < 0) {
+		fprintf(stderr, "The compare tolerance cannot be negative\n");
+		exit(1);
+	}
+	state->archive_dir = cl->archive.value;
+	state->queries = cl->queries;
+	if (state->queries != NULL && state->archive_dir == NULL) {
+		fprintf(stderr, "A query needs an archive, use --archive\n");
+		exit(1);
+	}
+	parse_write_policy(&cl->write_policy, &state->write_policy);
 	parse_baudrate(&cl->baudrate, &state->baudrate);
 	parse_sample_rate(&cl->sample_rate, &state->sample_rate);
+	state->auto_rate = cl->auto_rate;
 	parse_boolean("external clock",
 		      &cl->external_clock, &state->external_clock);
 	parse_boolean("invert external clock",
 		      &cl->external_invert, &state->external_invert);
 	parse_boolean("filter input module", &cl->filter, &state->filter);
+	if (state->auto_rate
+	    && (state->external_clock || state->input_files != NULL)) {
+		fprintf(stderr, "--auto-rate needs the internal clock and a "
+			"capture from the device\n");
+		exit(1);
+	}
+	/* Nothing is captured, the queries name the archived signals */
+	if (state->queries != NULL)
+		return;
 	parse_signals(cl->signals, state);
+	parse_deglitch(cl->deglitch, state);
 	parse_trigger_split(&cl->trigger_split, state);
+	parse_soft_window(&cl->soft_window, state);
 }
 
 void setup_configuration(int argc, gchar *argv[], struct state *state)
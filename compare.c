@@ -0,0 +1,206 @@
+/* -*- linux-c -*-
+ *
+ * Comparison of a capture against a golden reference
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compare.h"
+#include "capfile.h"
+
+struct compare {
+	struct state *state;
+	struct capture *golden;
+	guint32 *masks; /* Bits of each signal to compare, by index */
+};
+
+struct compare *compare_setup(struct state *state)
+{
+	struct compare *r = g_malloc0(sizeof(*r));
+	glong sample_rate;
+
+	r->state = state;
+	r->masks = g_malloc(MAX(state->noof_signals, 1) * sizeof(*r->masks));
+	for (gint i = 0; i < state->noof_signals; i++)
+		r->masks[i] = 0xFFFFFFFF;
+
+	for (gint i = 0; state->compare_masks && state->compare_masks[i];
+	     i++) {
+		gchar *name = g_strdup(state->compare_masks[i]);
+		gchar *value = strchr(name, '=');
+		struct signal_def *s;
+		gchar *tail = NULL;
+
+		if (value != NULL)
+			*value++ = 0;
+		s = value ? state_lookup_signal(state, name) : NULL;
+		if (s != NULL)
+			r->masks[s->index] = strtoul(value, &tail, 0);
+		if (s == NULL || tail == value || *tail != 0) {
+			fprintf(stderr,
+				"Cannot parse compare mask \"%s\", expected "
+				"<signal>=<mask>\n", state->compare_masks[i]);
+			g_free(name);
+			goto error;
+		}
+		g_free(name);
+	}
+
+	r->golden = capfile_load(state, state->compare_file, &sample_rate);
+	if (r->golden == NULL)
+		goto error;
+	if (sample_rate != state->sample_rate) {
+		fprintf(stderr,
+			"%s: Captured at %ld Hz, not at %ld Hz\n",
+			state->compare_file, sample_rate, state->sample_rate);
+		goto error;
+	}
+	return r;
+error:
+	compare_free(r);
+	return NULL;
+}
+
+void compare_free(struct compare *compare)
+{
+	if (compare->golden != NULL)
+		capture_free(compare->golden);
+	g_free(compare->masks);
+	g_free(compare);
+}
+
+/*
+ * Set every sample within tolerance samples of a set sample. The
+ * window covered doubles with each step, so this takes a logarithmic
+ * number of passes over the plane.
+ */
+static void dilate(guint64 *p, gint words, gint tolerance)
+{
+	guint64 *tmp = g_malloc(MAX(words, 1) * sizeof(*tmp));
+
+	for (gint covered = 0, step; covered < tolerance; covered += step) {
+		step = MIN(covered + 1, tolerance - covered);
+		memcpy(tmp, p, words * sizeof(*tmp));
+		capture_bitplane_shift_or(p, tmp, words, step);
+		capture_bitplane_shift_or(p, tmp, words, -step);
+	}
+	g_free(tmp);
+}
+
+/*
+ * Mark the samples in [lo, lo + n) where the channel differs from the
+ * golden capture in bad, and a difference is not explained by an
+ * edge moved by at most the tolerance.
+ */
+static void compare_channel(struct compare *compare, struct capture *capture,
+			    gint channel, gint lo, gint offset, gint n,
+			    guint64 *bad)
+{
+	gint words = (n + 63) / 64;
+	gint tolerance = compare->state->compare_tolerance;
+	guint64 *cur = capture_bitplane_range(capture, channel, lo, n);
+	guint64 *gold = capture_bitplane_range(compare->golden, channel,
+					       lo - offset, n);
+	guint64 *gold0;
+
+	if (tolerance == 0) {
+		for (gint w = 0; w < words; w++)
+			bad[w] |= cur[w] ^ gold[w];
+		goto done;
+	}
+
+	/* Where the golden capture is 0 within the tolerance */
+	gold0 = g_malloc(MAX(words, 1) * sizeof(*gold0));
+	for (gint w = 0; w < words; w++)
+		gold0[w] = ~gold[w];
+	if (n % 64)
+		gold0[words - 1] &= ((guint64)1 << (n % 64)) - 1;
+	dilate(gold0, words, tolerance);
+	dilate(gold, words, tolerance);
+	for (gint w = 0; w < words; w++)
+		bad[w] |= (cur[w] & ~gold[w]) | (~cur[w] & ~gold0[w]);
+	g_free(gold0);
+done:
+	if (n % 64)
+		bad[words - 1] &= ((guint64)1 << (n % 64)) - 1;
+	g_free(cur);
+	g_free(gold);
+}
+
+gboolean compare_run(struct compare *compare, struct capture *capture,
+		     gboolean *match)
+{
+	struct state *state = compare->state;
+	struct capture *golden = compare->golden;
+	gint offset = capture->trigger - golden->trigger;
+	gint lo = MAX(0, offset);
+	gint hi = MIN(capture->noof_samples, golden->noof_samples + offset);
+	gint n = hi - lo;
+	gint words = (n + 63) / 64;
+	gint noof_windows = 0;
+	gint first = G_MAXINT;
+	gchar *first_signal = NULL;
+	guint64 *bad;
+
+	if (n <= 0) {
+		fprintf(stderr, "The captures do not overlap when aligned on "
+			"their trigger points\n");
+		return FALSE;
+	}
+
+	bad = g_malloc(words * sizeof(*bad));
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+		guint32 mask = compare->masks[s->index];
+
+		memset(bad, 0, words * sizeof(*bad));
+		for (gint bit = 0; bit < s->noof_bits; bit++)
+			if (mask & (1 << bit))
+				compare_channel(compare, capture,
+						s->channels[bit],
+						lo, offset, n, bad);
+
+		/* Report every run of diverging samples */
+		for (gint start = capture_bitplane_find(bad, n, 0, TRUE), end;
+		     start < n;
+		     start = capture_bitplane_find(bad, n, end, TRUE)) {
+			end = capture_bitplane_find(bad, n, start, FALSE);
+			printf("%s: %d to %d\n", s->name,
+			       lo + start - capture->trigger,
+			       lo + end - 1 - capture->trigger);
+			if (lo + start - capture->trigger < first) {
+				first = lo + start - capture->trigger;
+				first_signal = s->name;
+			}
+			noof_windows++;
+		}
+	}
+	g_free(bad);
+
+	*match = noof_windows == 0;
+	if (*match)
+		printf("PASS: No divergence in %d samples\n", n);
+	else
+		printf("FAIL: %d divergence windows, the first at sample %d "
+		       "from the trigger in %s\n",
+		       noof_windows, first, first_signal);
+	return TRUE;
+}
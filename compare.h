@@ -0,0 +1,50 @@
+/* -*- linux-c -*-
+ *
+ * Comparison of a capture against a golden reference
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _COMPARE_H_
+#define _COMPARE_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+struct compare;
+
+/*
+ * Load the golden capture and parse the signal masks given in the
+ * state. Return NULL on error.
+ */
+struct compare *compare_setup(struct state *state);
+
+void compare_free(struct compare *compare);
+
+/*
+ * Compare the capture against the golden one, aligned on their
+ * trigger points, and report every window of samples in which they
+ * diverge on stdout. Return FALSE on error, otherwise *match tells
+ * if there were no divergences.
+ */
+gboolean compare_run(struct compare *compare, struct capture *capture,
+		     gboolean *match);
+
+#endif /* _COMPARE_H_ */
@@ -0,0 +1,640 @@
+/* -*- linux-c -*-
+ *
+ * Protocol decoders
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+#include "output.h"
+
+#define MAX_PINS 4
+
+/*
+ * Each protocol is a state machine given by a table indexed by the
+ * current state and an input event, the events are derived from the
+ * edges of the signals the decoder is bound to. A transition gives
+ * the next state and an action, an action may override the next
+ * state (e.g. when the last bit of a word has been shifted in).
+ */
+struct transition {
+	gint next;
+	gint action;
+};
+
+/* A decoded transaction */
+struct decode_event {
+	gint sample;
+	gint decoder;
+	gint seq;
+	gchar *text;
+};
+
+struct decoder {
+	gint index;
+	gchar *name;
+	const struct protocol *protocol;
+	gint pins[MAX_PINS]; /* Channels, -1 if not bound */
+
+	/* Settings */
+	glong baud;
+	gint bits;
+	gint parity; /* 0 none, 1 odd, 2 even */
+	gint mode;
+
+	struct capture *capture;
+	GArray *events;
+	GThread *thread;
+};
+
+struct protocol {
+	const gchar *name;
+	const gchar *pins[MAX_PINS];
+	guint32 required; /* Bit-vector of required pins */
+	void (*run)(struct decoder *d);
+};
+
+struct decode {
+	struct state *state;
+	gint noof_decoders;
+	struct decoder *decoders;
+};
+
+static void emit(struct decoder *d, gint sample, gchar *text)
+{
+	struct decode_event e = {
+		.sample = sample,
+		.decoder = d->index,
+		.seq = d->events->len,
+		.text = text
+	};
+
+	g_array_append_val(d->events, e);
+}
+
+static gint pin_value(struct decoder *d, gint pin, gint sample)
+{
+	return (d->capture->samples[sample] >> d->pins[pin]) & 1;
+}
+
+/* UART */
+
+enum { UART_RX };
+enum { UART_IDLE, UART_START, UART_DATA, UART_PARITY, UART_STOP,
+       UART_NOOF_STATES };
+enum { UART_FALL, UART_BIT0, UART_BIT1, UART_NOOF_EVENTS };
+enum { UART_NONE, UART_BEGIN, UART_SHIFT, UART_CHECK, UART_END,
+       UART_FRAMING, UART_REJECT };
+
+static const struct transition uart_table[UART_NOOF_STATES]
+[UART_NOOF_EVENTS] = {
+	[UART_IDLE] = {
+		[UART_FALL] = { UART_START, UART_BEGIN },
+		[UART_BIT0] = { UART_IDLE, UART_NONE },
+		[UART_BIT1] = { UART_IDLE, UART_NONE } },
+	[UART_START] = {
+		/* A start bit which does not last is a glitch */
+		[UART_BIT0] = { UART_DATA, UART_NONE },
+		[UART_BIT1] = { UART_IDLE, UART_REJECT } },
+	[UART_DATA] = {
+		[UART_BIT0] = { UART_DATA, UART_SHIFT },
+		[UART_BIT1] = { UART_DATA, UART_SHIFT } },
+	[UART_PARITY] = {
+		[UART_BIT0] = { UART_STOP, UART_CHECK },
+		[UART_BIT1] = { UART_STOP, UART_CHECK } },
+	[UART_STOP] = {
+		[UART_BIT0] = { UART_IDLE, UART_FRAMING },
+		[UART_BIT1] = { UART_IDLE, UART_END } },
+};
+
+static void uart_run(struct decoder *d)
+{
+	struct capture *capture = d->capture;
+	gint channel = d->pins[UART_RX];
+	gdouble bit_time = (gdouble)capture->state->sample_rate / d->baud;
+	gint state = UART_IDLE;
+	gint start = 0, bitno = 0, edge = 0;
+	guint32 word = 0;
+	gint bits = 0;
+	gboolean parity_error = FALSE;
+
+	while (TRUE) {
+		const struct transition *t;
+		gint event, sample;
+
+		if (state == UART_IDLE) {
+			/* Wait for the falling edge of a start bit */
+			for (; edge < capture->noof_edges[channel]; edge++)
+				if (!pin_value(d, UART_RX,
+					       capture->edges[channel][edge]))
+					break;
+			if (edge == capture->noof_edges[channel])
+				break;
+			sample = capture->edges[channel][edge];
+			event = UART_FALL;
+		} else {
+			/* Sample in the middle of the bit */
+			sample = start + (bitno++ + 0.5) * bit_time;
+			if (sample >= capture->noof_samples)
+				break;
+			event = pin_value(d, UART_RX, sample)
+				? UART_BIT1 : UART_BIT0;
+		}
+
+		t = &uart_table[state][event];
+		state = t->next;
+		switch (t->action) {
+		case UART_BEGIN:
+			start = sample;
+			bitno = 0;
+			word = 0;
+			bits = 0;
+			parity_error = FALSE;
+			break;
+		case UART_SHIFT:
+			/* Least significant bit first */
+			word |= (event == UART_BIT1) << bits;
+			if (++bits == d->bits)
+				state = d->parity ? UART_PARITY : UART_STOP;
+			break;
+		case UART_CHECK:
+			parity_error = (__builtin_popcount(word)
+					+ (event == UART_BIT1)
+					+ (d->parity == 1)) & 1;
+			break;
+		case UART_END:
+			emit(d, start, g_strdup_printf(
+				     "0x%02x%s", word,
+				     parity_error ? " parity-error" : ""));
+			break;
+		case UART_FRAMING:
+			emit(d, start, g_strdup_printf("0x%02x framing-error",
+						       word));
+			break;
+		}
+
+		/*
+		 * A start bit may follow right after a glitch, and after
+		 * the middle of the stop bit when the transmitter runs
+		 * fast, so do not wait for the nominal end of the frame.
+		 */
+		if (state == UART_IDLE)
+			edge = capture_find_edge(capture, channel,
+						 t->action == UART_REJECT
+						 ? start + 1 : sample + 1);
+	}
+}
+
+/* SPI */
+
+enum { SPI_CLK, SPI_MOSI, SPI_MISO, SPI_CS };
+enum { SPI_IDLE, SPI_ACTIVE, SPI_NOOF_STATES };
+enum { SPI_SELECT, SPI_DESELECT, SPI_SAMPLE, SPI_SHIFT_EDGE,
+       SPI_NOOF_EVENTS };
+enum { SPI_NONE, SPI_BEGIN, SPI_BIT, SPI_END };
+
+static const struct transition spi_table[SPI_NOOF_STATES]
+[SPI_NOOF_EVENTS] = {
+	[SPI_IDLE] = {
+		[SPI_SELECT] = { SPI_ACTIVE, SPI_BEGIN },
+		[SPI_DESELECT] = { SPI_IDLE, SPI_NONE },
+		[SPI_SAMPLE] = { SPI_IDLE, SPI_NONE },
+		[SPI_SHIFT_EDGE] = { SPI_IDLE, SPI_NONE } },
+	[SPI_ACTIVE] = {
+		[SPI_SELECT] = { SPI_ACTIVE, SPI_NONE },
+		[SPI_DESELECT] = { SPI_IDLE, SPI_END },
+		[SPI_SAMPLE] = { SPI_ACTIVE, SPI_BIT },
+		[SPI_SHIFT_EDGE] = { SPI_ACTIVE, SPI_NONE } },
+};
+
+static void spi_emit(struct decoder *d, gint sample, guint32 mosi,
+		     guint32 miso, gint bits)
+{
+	GString *s = g_string_new(NULL);
+
+	if (d->pins[SPI_MOSI] != -1)
+		g_string_append_printf(s, "mosi 0x%0*x", (bits + 3) / 4, mosi);
+	if (d->pins[SPI_MISO] != -1)
+		g_string_append_printf(s, "%smiso 0x%0*x", s->len ? " " : "",
+				       (bits + 3) / 4, miso);
+	if (bits != d->bits)
+		g_string_append_printf(s, " incomplete %d bits", bits);
+	emit(d, sample, g_string_free(s, FALSE));
+}
+
+static void spi_run(struct decoder *d)
+{
+	struct capture *capture = d->capture;
+	sample_t clk = (sample_t)1 << d->pins[SPI_CLK];
+	sample_t cs = d->pins[SPI_CS] != -1
+		? (sample_t)1 << d->pins[SPI_CS] : 0;
+	/* Modes 0 and 3 sample on the rising edge, 1 and 2 on falling */
+	gboolean sample_rising = ((d->mode >> 1) & 1) == (d->mode & 1);
+	gint state = SPI_ACTIVE;
+	guint32 mosi = 0, miso = 0;
+	gint bits = 0, start = 0;
+
+	if (cs && pin_value(d, SPI_CS, 0))
+		state = SPI_IDLE;
+
+	for (gint c = 0; c < capture->noof_changes; c++) {
+		gint sample = capture->changes[c].sample;
+		sample_t diff = capture->changes[c].diff;
+		gint events[2], noof_events = 0;
+
+		/* A change of the chip select is handled before the clock */
+		if (diff & cs)
+			events[noof_events++] = capture->samples[sample] & cs
+				? SPI_DESELECT : SPI_SELECT;
+		if (diff & clk)
+			events[noof_events++] =
+				!!(capture->samples[sample] & clk)
+				== sample_rising
+				? SPI_SAMPLE : SPI_SHIFT_EDGE;
+
+		for (gint e = 0; e < noof_events; e++) {
+			const struct transition *t = &spi_table[state]
+				[events[e]];
+
+			state = t->next;
+			switch (t->action) {
+			case SPI_BEGIN:
+				bits = 0;
+				mosi = 0;
+				miso = 0;
+				break;
+			case SPI_BIT:
+				if (bits == 0)
+					start = sample;
+				/* Most significant bit first */
+				if (d->pins[SPI_MOSI] != -1)
+					mosi = (mosi << 1)
+						| pin_value(d, SPI_MOSI,
+							    sample);
+				if (d->pins[SPI_MISO] != -1)
+					miso = (miso << 1)
+						| pin_value(d, SPI_MISO,
+							    sample);
+				if (++bits == d->bits) {
+					spi_emit(d, start, mosi, miso, bits);
+					bits = 0;
+					mosi = 0;
+					miso = 0;
+				}
+				break;
+			case SPI_END:
+				if (bits > 0)
+					spi_emit(d, start, mosi, miso, bits);
+				break;
+			}
+		}
+	}
+}
+
+/* I2C */
+
+enum { I2C_SCL, I2C_SDA };
+enum { I2C_IDLE, I2C_ADDRESS, I2C_ADDRESS_ACK, I2C_DATA, I2C_DATA_ACK,
+       I2C_NOOF_STATES };
+enum { I2C_START, I2C_STOP, I2C_BIT0, I2C_BIT1, I2C_NOOF_EVENTS };
+enum { I2C_NONE, I2C_BEGIN, I2C_END, I2C_SHIFT, I2C_ACK_ADDRESS,
+       I2C_ACK_DATA };
+
+static const struct transition i2c_table[I2C_NOOF_STATES]
+[I2C_NOOF_EVENTS] = {
+	[I2C_IDLE] = {
+		[I2C_START] = { I2C_ADDRESS, I2C_BEGIN },
+		[I2C_STOP] = { I2C_IDLE, I2C_NONE },
+		[I2C_BIT0] = { I2C_IDLE, I2C_NONE },
+		[I2C_BIT1] = { I2C_IDLE, I2C_NONE } },
+	[I2C_ADDRESS] = {
+		[I2C_START] = { I2C_ADDRESS, I2C_BEGIN },
+		[I2C_STOP] = { I2C_IDLE, I2C_END },
+		[I2C_BIT0] = { I2C_ADDRESS, I2C_SHIFT },
+		[I2C_BIT1] = { I2C_ADDRESS, I2C_SHIFT } },
+	[I2C_ADDRESS_ACK] = {
+		[I2C_START] = { I2C_ADDRESS, I2C_BEGIN },
+		[I2C_STOP] = { I2C_IDLE, I2C_END },
+		[I2C_BIT0] = { I2C_DATA, I2C_ACK_ADDRESS },
+		[I2C_BIT1] = { I2C_DATA, I2C_ACK_ADDRESS } },
+	[I2C_DATA] = {
+		[I2C_START] = { I2C_ADDRESS, I2C_BEGIN },
+		[I2C_STOP] = { I2C_IDLE, I2C_END },
+		[I2C_BIT0] = { I2C_DATA, I2C_SHIFT },
+		[I2C_BIT1] = { I2C_DATA, I2C_SHIFT } },
+	[I2C_DATA_ACK] = {
+		[I2C_START] = { I2C_ADDRESS, I2C_BEGIN },
+		[I2C_STOP] = { I2C_IDLE, I2C_END },
+		[I2C_BIT0] = { I2C_DATA, I2C_ACK_DATA },
+		[I2C_BIT1] = { I2C_DATA, I2C_ACK_DATA } },
+};
+
+static void i2c_run(struct decoder *d)
+{
+	struct capture *capture = d->capture;
+	sample_t scl = (sample_t)1 << d->pins[I2C_SCL];
+	sample_t sda = (sample_t)1 << d->pins[I2C_SDA];
+	gint state = I2C_IDLE;
+	guint32 byte = 0;
+	gint bits = 0, start = 0;
+
+	for (gint c = 0; c < capture->noof_changes; c++) {
+		gint sample = capture->changes[c].sample;
+		sample_t diff = capture->changes[c].diff;
+		sample_t now = capture->samples[sample];
+		sample_t before = capture->samples[sample - 1];
+		const struct transition *t;
+		gint event;
+
+		if ((diff & sda) && !(diff & scl) && (now & scl))
+			/* SDA changing while SCL is high */
+			event = now & sda ? I2C_STOP : I2C_START;
+		else if ((diff & scl) && (now & scl) && !(before & scl))
+			event = now & sda ? I2C_BIT1 : I2C_BIT0;
+		else
+			continue;
+
+		t = &i2c_table[state][event];
+		state = t->next;
+		switch (t->action) {
+		case I2C_BEGIN:
+			emit(d, sample, g_strdup("start"));
+			bits = 0;
+			byte = 0;
+			break;
+		case I2C_END:
+			emit(d, sample, g_strdup("stop"));
+			break;
+		case I2C_SHIFT:
+			if (bits == 0)
+				start = sample;
+			byte = (byte << 1) | (event == I2C_BIT1);
+			if (++bits == 8)
+				state = state == I2C_ADDRESS
+					? I2C_ADDRESS_ACK : I2C_DATA_ACK;
+			break;
+		case I2C_ACK_ADDRESS:
+			emit(d, start, g_strdup_printf(
+				     "address 0x%02x %s %s", byte >> 1,
+				     byte & 1 ? "read" : "write",
+				     event == I2C_BIT0 ? "ack" : "nack"));
+			bits = 0;
+			byte = 0;
+			break;
+		case I2C_ACK_DATA:
+			emit(d, start, g_strdup_printf(
+				     "data 0x%02x %s", byte,
+				     event == I2C_BIT0 ? "ack" : "nack"));
+			bits = 0;
+			byte = 0;
+			break;
+		}
+	}
+}
+
+static const struct protocol protocols[] = {
+	{ .name = "uart",
+	  .pins = { "rx" },
+	  .required = 1 << UART_RX,
+	  .run = uart_run },
+	{ .name = "spi",
+	  .pins = { "clk", "mosi", "miso", "cs" },
+	  .required = 1 << SPI_CLK,
+	  .run = spi_run },
+	{ .name = "i2c",
+	  .pins = { "scl", "sda" },
+	  .required = (1 << I2C_SCL) | (1 << I2C_SDA),
+	  .run = i2c_run },
+	{ .name = NULL }
+};
+
+static gboolean parse_integer(gchar *spec, gchar *key, gchar *value,
+			      glong *result)
+{
+	gchar *tail;
+
+	*result = strtol(value, &tail, 0);
+	if (tail == value || *tail != 0) {
+		fprintf(stderr, "Decoder %s: Cannot parse %s=%s\n",
+			spec, key, value);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean parse_setting(struct state *state, struct decoder *d,
+			      gchar *spec, gchar *key, gchar *value)
+{
+	glong v;
+
+	for (gint p = 0; p < MAX_PINS && d->protocol->pins[p]; p++) {
+		struct signal_def *s;
+
+		if (strcmp(key, d->protocol->pins[p]) != 0)
+			continue;
+		s = state_lookup_signal(state, value);
+		if (s == NULL || s->noof_bits != 1) {
+			fprintf(stderr,
+				"Decoder %s: %s must be a one bit signal\n",
+				spec, key);
+			return FALSE;
+		}
+		d->pins[p] = s->channels[0];
+		return TRUE;
+	}
+
+	if (strcmp(key, "name") == 0) {
+		g_free(d->name);
+		d->name = g_strdup(value);
+	} else if (strcmp(key, "parity") == 0) {
+		if (strcmp(value, "none") == 0)
+			d->parity = 0;
+		else if (strcmp(value, "odd") == 0)
+			d->parity = 1;
+		else if (strcmp(value, "even") == 0)
+			d->parity = 2;
+		else {
+			fprintf(stderr, "Decoder %s: Unknown parity %s\n",
+				spec, value);
+			return FALSE;
+		}
+	} else if (strcmp(key, "baud") == 0) {
+		if (!parse_integer(spec, key, value, &d->baud))
+			return FALSE;
+	} else if (strcmp(key, "bits") == 0) {
+		if (!parse_integer(spec, key, value, &v))
+			return FALSE;
+		d->bits = v;
+	} else if (strcmp(key, "mode") == 0) {
+		if (!parse_integer(spec, key, value, &v))
+			return FALSE;
+		d->mode = v;
+	} else {
+		fprintf(stderr, "Decoder %s: Unknown setting %s\n", spec, key);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean parse_decoder(struct state *state, struct decoder *d,
+			      gchar *spec)
+{
+	gchar **settings = NULL;
+	gchar *colon = strchr(spec, ':');
+	gsize length = colon ? colon - spec : strlen(spec);
+	gboolean success = FALSE;
+
+	for (d->protocol = protocols; d->protocol->name; d->protocol++)
+		if (strlen(d->protocol->name) == length
+		    && strncmp(spec, d->protocol->name, length) == 0)
+			break;
+	if (d->protocol->name == NULL) {
+		fprintf(stderr, "Decoder %s: Unknown protocol\n", spec);
+		goto error;
+	}
+
+	d->name = g_strdup_printf("%s%d", d->protocol->name, d->index);
+	for (gint p = 0; p < MAX_PINS; p++)
+		d->pins[p] = -1;
+	d->bits = 8;
+
+	settings = g_strsplit(colon ? colon + 1 : "", ",", -1);
+	for (gint i = 0; settings[i] != NULL; i++) {
+		gchar *value = strchr(settings[i], '=');
+
+		if (*settings[i] == 0)
+			continue;
+		if (value == NULL) {
+			fprintf(stderr, "Decoder %s: Expected <key>=<value> "
+				"at %s\n", spec, settings[i]);
+			goto error;
+		}
+		*value++ = 0;
+		if (!parse_setting(state, d, spec, settings[i], value))
+			goto error;
+	}
+
+	for (gint p = 0; p < MAX_PINS; p++)
+		if ((d->protocol->required & (1 << p)) && d->pins[p] == -1) {
+			fprintf(stderr, "Decoder %s: %s must be given\n",
+				spec, d->protocol->pins[p]);
+			goto error;
+		}
+	if (d->bits < 1 || d->bits > 32 || d->mode < 0 || d->mode > 3) {
+		fprintf(stderr, "Decoder %s: Invalid bits or mode\n", spec);
+		goto error;
+	}
+	if (d->protocol->run == uart_run
+	    && (d->baud <= 0 || state->sample_rate < 2 * d->baud)) {
+		fprintf(stderr,
+			"Decoder %s: The baud rate must be given and be at "
+			"most half the sample rate\n", spec);
+		goto error;
+	}
+	success = TRUE;
+error:
+	g_strfreev(settings);
+	return success;
+}
+
+struct decode *decode_setup(struct state *state)
+{
+	struct decode *r = g_malloc0(sizeof(*r));
+
+	r->state = state;
+	r->noof_decoders = g_strv_length(state->decoders);
+	r->decoders = g_malloc0(r->noof_decoders * sizeof(*r->decoders));
+	for (gint i = 0; i < r->noof_decoders; i++) {
+		r->decoders[i].index = i;
+		if (!parse_decoder(state, &r->decoders[i],
+				   state->decoders[i])) {
+			decode_free(r);
+			return NULL;
+		}
+	}
+	return r;
+}
+
+void decode_free(struct decode *decode)
+{
+	for (gint i = 0; i < decode->noof_decoders; i++)
+		g_free(decode->decoders[i].name);
+	g_free(decode->decoders);
+	g_free(decode);
+}
+
+static gpointer decoder_thread(gpointer data)
+{
+	struct decoder *d = data;
+
+	d->protocol->run(d);
+	return NULL;
+}
+
+static gint compare_events(gconstpointer a, gconstpointer b)
+{
+	const struct decode_event *x = a, *y = b;
+
+	if (x->sample != y->sample)
+		return x->sample < y->sample ? -1 : 1;
+	if (x->decoder != y->decoder)
+		return x->decoder < y->decoder ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+gboolean decode_run(struct decode *decode, struct capture *capture)
+{
+	GArray *all = g_array_new(FALSE, FALSE, sizeof(struct decode_event));
+	struct output *out;
+
+	for (gint i = 0; i < decode->noof_decoders; i++) {
+		struct decoder *d = &decode->decoders[i];
+
+		d->capture = capture;
+		d->events = g_array_new(FALSE, FALSE,
+					sizeof(struct decode_event));
+		d->thread = g_thread_new(d->name, decoder_thread, d);
+	}
+	for (gint i = 0; i < decode->noof_decoders; i++) {
+		struct decoder *d = &decode->decoders[i];
+
+		g_thread_join(d->thread);
+		g_array_append_vals(all, d->events->data, d->events->len);
+		g_array_free(d->events, TRUE);
+	}
+	g_array_sort(all, compare_events);
+
+	out = output_open(decode->state->decode_outfile, FALSE, 0);
+	if (out != NULL) {
+		for (guint i = 0; i < all->len; i++) {
+			struct decode_event *e = &g_array_index(
+				all, struct decode_event, i);
+
+			output_printf(out, "%d %s %s\n", e->sample,
+				      decode->decoders[e->decoder].name,
+				      e->text);
+		}
+	}
+	for (guint i = 0; i < all->len; i++)
+		g_free(g_array_index(all, struct decode_event, i).text);
+	g_array_free(all, TRUE);
+	return out != NULL && output_close(out);
+}
@@ -0,0 +1,47 @@
+/* -*- linux-c -*-
+ *
+ * Protocol decoders
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _DECODE_H_
+#define _DECODE_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+struct decode;
+
+/*
+ * Set up the decoders given in the state, each a string of the form
+ * <protocol>:<key>=<value>,... Return NULL on error.
+ */
+struct decode *decode_setup(struct state *state);
+
+void decode_free(struct decode *decode);
+
+/*
+ * Run all decoders on the capture, each in its own thread, and write
+ * the decoded transactions in time order to the decode output.
+ */
+gboolean decode_run(struct decode *decode, struct capture *capture);
+
+#endif /* _DECODE_H_ */
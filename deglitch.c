@@ -0,0 +1,111 @@
+/* -*- linux-c -*-
+ *
+ * Software glitch filter
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <string.h>
+#include "deglitch.h"
+
+/* Set the samples in [start, end) of the plane */
+static void set_range(guint64 *plane, gint start, gint end)
+{
+	for (; start < end && start % 64; start++)
+		plane[start / 64] |= (guint64)1 << (start % 64);
+	for (; start + 64 <= end; start += 64)
+		plane[start / 64] = ~(guint64)0;
+	for (; start < end; start++)
+		plane[start / 64] |= (guint64)1 << (start % 64);
+}
+
+/*
+ * All the work on the channel is done on bitplanes, 64 samples to a
+ * word. Only the changes which are kept are visited one by one.
+ */
+static void deglitch_channel(struct capture *capture, gint channel,
+			     gint width)
+{
+	gint n = capture->noof_samples;
+	gint words = (n + 63) / 64;
+	guint64 *x = capture_bitplane(capture, channel);
+	guint64 *edges = g_malloc(MAX(words, 1) * sizeof(*edges));
+	guint64 *near = g_malloc0(MAX(words, 1) * sizeof(*near));
+	guint64 *tmp = g_malloc(MAX(words, 1) * sizeof(*tmp));
+	guint64 *y, rejected = 0;
+	gint start = 0, held;
+
+	/* Sample i is an edge if it differs from sample i - 1 */
+	for (gint w = 0; w < words; w++)
+		edges[w] = x[w] ^ ((x[w] << 1)
+				   | (w ? x[w - 1] >> 63 : x[0] & 1));
+	if (n % 64)
+		edges[words - 1] &= ((guint64)1 << (n % 64)) - 1;
+
+	/* Mark the samples with another edge less than width after them */
+	capture_bitplane_shift_or(near, edges, words, -1);
+	for (gint covered = 1, step; covered < width - 1; covered += step) {
+		step = MIN(covered, width - 1 - covered);
+		memcpy(tmp, near, words * sizeof(*tmp));
+		capture_bitplane_shift_or(near, tmp, words, -step);
+	}
+	for (gint w = 0; w < words; w++) {
+		rejected |= edges[w] & near[w];
+		edges[w] &= ~near[w];
+	}
+	if (!rejected)
+		goto done;
+
+	/* Hold the value between the kept changes */
+	y = near;
+	memset(y, 0, words * sizeof(*y));
+	held = x[0] & 1;
+	for (gint w = 0; w < words; w++)
+		for (guint64 e = edges[w]; e; e &= e - 1) {
+			gint i = w * 64 + __builtin_ctzll(e);
+
+			if (((x[w] >> (i % 64)) & 1) == held)
+				continue;
+			if (held)
+				set_range(y, start, i);
+			start = i;
+			held = !held;
+		}
+	if (held)
+		set_range(y, start, n);
+
+	for (gint i = 0; i < n; i++)
+		capture->samples[i] = (capture->samples[i]
+				       & ~((sample_t)1 << channel))
+			| ((sample_t)((y[i / 64] >> (i % 64)) & 1) << channel);
+done:
+	g_free(x);
+	g_free(edges);
+	g_free(near);
+	g_free(tmp);
+}
+
+void deglitch_channels(struct capture *capture, gint first, gint last)
+{
+	struct state *state = capture->state;
+
+	for (gint c = first; c < last; c++)
+		if (state->deglitch_width[c] > 1)
+			deglitch_channel(capture, c,
+					 state->deglitch_width[c]);
+}
@@ -0,0 +1,38 @@
+/* -*- linux-c -*-
+ *
+ * Software glitch filter
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _DEGLITCH_H_
+#define _DEGLITCH_H_
+
+#include "capture.h"
+
+/*
+ * Filter the channels in [first, last) which have a minimum pulse
+ * width in the state. A change of a channel is only kept if the
+ * channel then holds its new value for at least the minimum width,
+ * otherwise the previous value is held. The edge index is not
+ * updated.
+ */
+void deglitch_channels(struct capture *capture, gint first, gint last);
+
+#endif /* _DEGLITCH_H_ */
@@ -0,0 +1,334 @@
+/* -*- linux-c -*-
+ *
+ * Capturing from a SUMP device
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+#include "device.h"
+#include "sump.h"
+#include "serial.h"
+#include "trigger.h"
+#include "profile.h"
+#include "probes.h"
+
+#define AUTO_RATE_MIN 1000 /* Hz, the slowest probe capture */
+#define AUTO_RATE_STEP 16 /* Between the rates of probe captures */
+#define AUTO_RATE_MARGIN 20 /* 1/20 of each side of the trigger is kept */
+
+static gboolean setup_hardware(int port, struct state *state)
+{
+	gboolean success = FALSE;
+	guint32 ident;
+
+	profile_begin(PROFILE_DRAIN);
+	if (!sump_drain_input(port)) {
+		fprintf(stderr, "Failed to drain input\n");
+		goto error;
+	}
+	profile_end(PROFILE_DRAIN);
+
+	profile_begin(PROFILE_IDENT);
+	if (!sump_cmd_reset(port)) {
+		fprintf(stderr, "Reset failed\n");
+		goto error;
+	}
+
+	if (!sump_cmd_id(port, &ident)) {
+		fprintf(stderr, "Ident failed\n");
+		goto error;
+	}
+	if (ident != 0x534c4131) {
+		fprintf(stderr, "Ident failed, device returned 0x%x\n", ident);
+		goto error;
+	}
+	profile_end(PROFILE_IDENT);
+	success = TRUE;
+error:
+	return success;
+}
+
+static gboolean setup_triggers(int port, struct state *state)
+{
+	gboolean success = FALSE;
+	if (!trigger_compile(state))
+		goto error;
+	for (gint i = 0; i < NOOF_TRIGGERS; i++)
+		if (!sump_cmd_set_trigger(port, state->triggers + i)) {
+			fprintf(stderr, "Failed to set up trigger\n");
+			goto error;
+		}
+	success = TRUE;
+error:
+	return success;
+}
+
+gboolean device_clock(struct state *state, guint32 *divider,
+		      guint32 *flags)
+{
+	*flags = 0;
+	if (state->sample_rate > CLOCK_FREQ &&
+	    state_noof_channel_groups_in_use(state) > 2) {
+		fprintf(stderr,
+			"Cannot handle clock frequency of %ld when %d "
+			"channel groups are used.\n",
+			state->sample_rate,
+			state_noof_channel_groups_in_use(state));
+		return FALSE;
+	}
+
+	if (state->sample_rate > CLOCK_FREQ)
+		*divider = (2 * CLOCK_FREQ / state->sample_rate) - 1;
+	else
+		*divider = (CLOCK_FREQ / state->sample_rate) - 1;
+	if (state->sample_rate > CLOCK_FREQ) {
+		*flags |= SUMP_FLAG_DEMUX;
+	}
+	if ((*flags & SUMP_FLAG_DEMUX) && state->filter) {
+		fprintf(stderr,
+			"Cannot use the filter at the current sample rate\n");
+		return FALSE;
+	}
+	if (state->filter)
+		*flags |= SUMP_FLAG_FILTER;
+	if (state->external_clock)
+		*flags |= SUMP_FLAG_EXTERNAL_CLOCK;
+	if (state->external_invert)
+		*flags |= SUMP_FLAG_INVERT_EXTERNAL_CLOCK;
+	return TRUE;
+}
+
+glong device_sample_rate(guint32 divider, guint32 flags)
+{
+	if (flags & SUMP_FLAG_DEMUX)
+		return 2 * (glong)CLOCK_FREQ / (divider + 1);
+	return CLOCK_FREQ / (divider + 1);
+}
+
+static gboolean setup_capture(int port, struct state *state)
+{
+	gboolean success = FALSE;
+	guint32 divider, flags;
+	guint32 buffer_capacity;
+
+	if (!device_clock(state, &divider, &flags))
+		goto error;
+	if (!sump_cmd_set_divider(port, divider)) {
+		fprintf(stderr, "Failed to set divider\n");
+		goto error;
+	}
+	if ((state->channels_in_use & 0x000000FF) == 0)
+		flags |= SUMP_FLAG_CHANNEL_GROUP_0_DISABLED;
+	if ((state->channels_in_use & 0x0000FF00) == 0)
+		flags |= SUMP_FLAG_CHANNEL_GROUP_1_DISABLED;
+	if ((state->channels_in_use & 0x00FF0000) == 0)
+		flags |= SUMP_FLAG_CHANNEL_GROUP_2_DISABLED;
+	if ((state->channels_in_use & 0xFF000000) == 0)
+		flags |= SUMP_FLAG_CHANNEL_GROUP_3_DISABLED;
+
+	if (!sump_cmd_set_flags(port, flags)) {
+		fprintf(stderr, "Failed to set flags\n");
+		goto error;
+	}
+
+	if (!setup_triggers(port, state)) {
+		fprintf(stderr, "Failed to set up triggers\n");
+		goto error;
+	}
+
+	buffer_capacity = state_buffer_capacity(state);
+	if (!sump_cmd_set_size(
+		    port, (buffer_capacity >> 2) - 1,
+		    ((buffer_capacity - state->trigger_holdoff) >> 2) - 1)) {
+	 	fprintf(stderr, "Failed to set size\n");
+		goto error;
+	}
+
+	success = TRUE;
+error:
+	return success;
+}
+
+gint device_open(struct state *state)
+{
+	gint port;
+
+	profile_begin(PROFILE_OPEN);
+	port = open_serial(state->device, state->baudrate);
+	profile_end(PROFILE_OPEN);
+	if (port == -1) {
+		perror("open_serial");
+		return -1;
+	}
+
+	if (!setup_hardware(port, state)) {
+		fprintf(stderr, "Failed to set up hardware\n");
+		close(port);
+		return -1;
+	}
+	return port;
+}
+
+guint8 *device_capture(gint port, struct state *state)
+{
+	guint8 *buffer;
+	guint32 buffer_size;
+
+	profile_begin(PROFILE_CONFIGURE);
+	if (!setup_capture(port, state)) {
+		fprintf(stderr, "Failed to set up capture\n");
+		return NULL;
+	}
+	profile_end(PROFILE_CONFIGURE);
+
+	buffer_size = state_buffer_capacity(state)
+		* state_noof_channel_groups_in_use(state);
+	buffer = g_malloc(buffer_size);
+
+	/* The first byte arrives when the trigger has fired */
+	profile_begin(PROFILE_WAIT);
+	if (!sump_cmd_run(port)) {
+		fprintf(stderr, "Failed to run\n");
+		goto error;
+	}
+	PROBE2(capture__armed, state->sample_rate, buffer_size);
+	if (!sump_read_buffer(port, 1, buffer, -1))
+		goto read_error;
+	profile_end(PROFILE_WAIT);
+	PROBE2(capture__triggered, state->sample_rate, buffer_size);
+
+	profile_begin(PROFILE_READBACK);
+	if (!sump_read_buffer(port, buffer_size - 1, buffer + 1, -1))
+		goto read_error;
+	profile_end(PROFILE_READBACK);
+	PROBE2(capture__complete, state->sample_rate, buffer_size);
+	return buffer;
+read_error:
+	fprintf(stderr, "Failed to read result\n");
+error:
+	g_free(buffer);
+	return NULL;
+}
+
+static glong max_sample_rate(struct state *state)
+{
+	if (state_noof_channel_groups_in_use(state) <= 2 && !state->filter)
+		return 2 * CLOCK_FREQ;
+	return CLOCK_FREQ;
+}
+
+/* The highest sample rate the divider can give which is at most rate */
+static glong snap_sample_rate(struct state *state, gdouble rate)
+{
+	glong divider;
+
+	if (rate >= max_sample_rate(state))
+		return max_sample_rate(state);
+	divider = MAX((glong)ceil(CLOCK_FREQ / rate) - 1, 0);
+	return CLOCK_FREQ / (divider + 1);
+}
+
+/*
+ * Return how many times the capture can be stretched around the
+ * trigger point with all changes still in the buffer, leaving a
+ * margin free at both ends. A change within a margin may be the end
+ * of activity which started outside the buffer, so it gives less
+ * than 1.
+ */
+static gdouble stretch(struct capture *capture)
+{
+	gint n = capture->noof_samples;
+	gint first = capture->changes[0].sample;
+	gint last = capture->changes[capture->noof_changes - 1].sample;
+	gint trigger = capture->trigger;
+	gint before = trigger / AUTO_RATE_MARGIN;
+	gint after = (n - trigger) / AUTO_RATE_MARGIN;
+	gdouble k = G_MAXDOUBLE;
+
+	if (first < trigger)
+		k = MIN(k, (gdouble)(trigger - before) / (trigger - first));
+	if (last > trigger)
+		k = MIN(k, (gdouble)(n - after - trigger) / (last - trigger));
+	return k;
+}
+
+/* The narrowest pulse on any channel in samples */
+static gint min_pulse_width(struct capture *capture)
+{
+	gint width = G_MAXINT;
+
+	for (gint c = 0; c < CAPTURE_NOOF_CHANNELS; c++)
+		for (gint e = 1; e < capture->noof_edges[c]; e++)
+			width = MIN(width, capture->edges[c][e]
+				    - capture->edges[c][e - 1]);
+	return width;
+}
+
+gboolean device_choose_sample_rate(gint port, struct state *state)
+{
+	glong configured = state->sample_rate;
+	glong rate = max_sample_rate(state);
+	glong previous = 0;
+	gboolean active = FALSE;
+
+	for (;;) {
+		struct capture *capture;
+		guint8 *buffer;
+		gdouble k = 0;
+
+		state->sample_rate = rate;
+		buffer = device_capture(port, state);
+		if (buffer == NULL)
+			return FALSE;
+		profile_begin(PROFILE_CONVERT);
+		capture = capture_new(state, buffer);
+		profile_end(PROFILE_CONVERT);
+		g_free(buffer);
+
+		if (capture->noof_changes > 0) {
+			if (previous && min_pulse_width(capture) < 2) {
+				capture_free(capture);
+				rate = previous;
+				break;
+			}
+			active = TRUE;
+			k = stretch(capture);
+		}
+		capture_free(capture);
+		if (k >= 1) {
+			rate = snap_sample_rate(state, rate * k);
+			break;
+		}
+		if (rate <= AUTO_RATE_MIN)
+			break;
+		previous = rate;
+		rate = snap_sample_rate(state, MAX(rate / AUTO_RATE_STEP,
+						   AUTO_RATE_MIN));
+	}
+	if (!active) {
+		fprintf(stderr, "The signals did not change in any probe, "
+			"keeping the sample rate of %ld Hz\n", configured);
+		rate = configured;
+	}
+	state->sample_rate = rate;
+	fprintf(stderr, "Using a sample rate of %ld Hz\n", rate);
+	return TRUE;
+}
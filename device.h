@@ -0,0 +1,65 @@
+/* -*- linux-c -*-
+ *
+ * Capturing from a SUMP device
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _DEVICE_H_
+#define _DEVICE_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+/*
+ * Compute the divider of the internal clock and the clock flags for
+ * the sample rate of the state. Return FALSE if the hardware cannot
+ * sample at that rate with the channel groups in use or the filter.
+ */
+gboolean device_clock(struct state *state, guint32 *divider,
+		      guint32 *flags);
+
+/* The sample rate which the divider and flags really give */
+glong device_sample_rate(guint32 divider, guint32 flags);
+
+/*
+ * Open the device and check that it answers as a SUMP device. Return
+ * the file descriptor or -1 on error.
+ */
+gint device_open(struct state *state);
+
+/*
+ * Configure the device for the state, capture and read the buffer.
+ * The device can be re-armed by calling this again. Return the raw
+ * buffer, which the caller frees, or NULL on error.
+ */
+guint8 *device_capture(gint port, struct state *state);
+
+/*
+ * Take probe captures from the highest sample rate down, by a factor
+ * of 16 at a time, until all activity fits in the buffer with a
+ * margin. The sample rate is then raised so the activity fills the
+ * buffer. Stepping down stops early if pulses become narrower than
+ * two samples, as edges may then be lost. The chosen rate is left in
+ * the state.
+ */
+gboolean device_choose_sample_rate(gint port, struct state *state);
+
+#endif /* _DEVICE_H_ */
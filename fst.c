@@ -0,0 +1,131 @@
+/* -*- linux-c -*-
+ *
+ * FST dumper
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "fst.h"
+#include "vcd.h"
+
+#ifdef HAVE_FST
+
+#include "fstapi.h"
+
+/*
+ * The signals are declared and the value changes emitted in the same
+ * way as for the VCD, the FST writer takes care of splitting the
+ * changes into compressed blocks with time tables.
+ */
+gboolean fst_dump(struct state *state, struct capture *capture)
+{
+	void *fst;
+	fstHandle handles[state->noof_signals];
+	fstHandle trigger = 0;
+	gchar value[CAPTURE_NOOF_CHANNELS + 1];
+	gint exponent, multiplier;
+	gint change = 0;
+	sample_t diff;
+	time_t t = time(NULL);
+	gchar *comment;
+
+	if (state->outfile == NULL) {
+		fprintf(stderr, "FST output cannot be written to stdout\n");
+		return FALSE;
+	}
+	if ((fst = fstWriterCreate(state->outfile, 1)) == NULL) {
+		fprintf(stderr, "Failed to create %s\n", state->outfile);
+		return FALSE;
+	}
+	fstWriterSetPackType(fst, FST_WR_PT_LZ4);
+
+	fstWriterSetDate(fst, ctime(&t));
+	fstWriterSetVersion(fst, "Open bench logic sniffer capture tool v"
+			    VERSION_STRING);
+	comment = g_strdup_printf("Sample rate %ld Hz, "
+				  "Number of samples %d",
+				  state->sample_rate, capture->noof_samples);
+	fstWriterSetComment(fst, comment);
+	g_free(comment);
+
+	/*
+	 * FST only has power of ten timescales, so the multiplier of
+	 * the VCD timescale goes into the timestamps instead.
+	 */
+	vcd_timescale(state, &exponent, &multiplier);
+	fstWriterSetTimescale(fst, exponent);
+
+	fstWriterSetScope(fst, FST_ST_VCD_MODULE, "logic", NULL);
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+
+		handles[s->index] = fstWriterCreateVar(
+			fst, FST_VT_VCD_WIRE, FST_VD_IMPLICIT,
+			s->noof_bits, s->name, 0);
+	}
+	if (state->trigger_spec != NULL || state->soft_trigger_spec != NULL)
+		trigger = fstWriterCreateVar(fst, FST_VT_VCD_EVENT,
+					     FST_VD_IMPLICIT, 1,
+					     "obls_trigger", 0);
+	fstWriterSetUpscope(fst);
+
+	/* Initial values */
+	fstWriterEmitTimeChange(fst, 0);
+	diff = ~0;
+	for (gint i = 0; i != -1;
+	     i = vcd_next_dump_point(capture, i, &change, &diff)) {
+		sample_t sample = capture->samples[i];
+
+		if (i != 0)
+			fstWriterEmitTimeChange(fst,
+						(guint64)i * multiplier);
+		if (i != 0 && i == capture->trigger && trigger != 0)
+			fstWriterEmitValueChange(fst, trigger, "1");
+		for (gint l = 0; l < state->noof_signals; l++) {
+			struct signal_def *s = &state->signals[l];
+			guint32 v;
+
+			if (!(s->mask & diff))
+				continue;
+			v = capture_signal_value(s, sample);
+			for (gint bit = 0; bit < s->noof_bits; bit++)
+				value[s->noof_bits - 1 - bit] =
+					(v & (1 << bit)) ? '1' : '0';
+			value[s->noof_bits] = 0;
+			fstWriterEmitValueChange(fst, handles[s->index],
+						 value);
+		}
+	}
+
+	fstWriterClose(fst);
+	return TRUE;
+}
+
+#else
+
+gboolean fst_dump(struct state *state, struct capture *capture)
+{
+	fprintf(stderr,
+		"FST output is not available, oblsc was built without "
+		"FSTAPI_DIR set\n");
+	return FALSE;
+}
+
+#endif /* HAVE_FST */
@@ -0,0 +1,190 @@
+/* -*- linux-c -*-
+ *
+ * Edge timing jitter over repeated captures
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <math.h>
+#include "jitter.h"
+#include "output.h"
+#include "stats.h"
+
+/*
+ * The position of one edge relative to the trigger over all captures.
+ * The mean and variance are updated with Welford's method, so nothing
+ * is kept per capture.
+ */
+struct edge_stats {
+	gint count;
+	gint reference; /* The position in the first capture */
+	gdouble mean;
+	gdouble m2; /* Sum of squared differences from the mean */
+	gint min;
+	gint max;
+	gint histogram[2 * JITTER_RANGE + 1];
+};
+
+struct jitter {
+	struct state *state;
+	gint noof_edges; /* Tracked on each side of the trigger */
+	gint captures;
+	gint missed;
+	/*
+	 * 2 * noof_edges per signal, the edges before the trigger
+	 * followed by the edges at or after it, in time order.
+	 */
+	struct edge_stats *edges;
+};
+
+struct jitter *jitter_new(struct state *state)
+{
+	struct jitter *r = g_malloc0(sizeof(*r));
+
+	r->state = state;
+	r->noof_edges = state->jitter_edges;
+	r->edges = g_malloc0(MAX(state->noof_signals, 1) * 2 * r->noof_edges
+			     * sizeof(*r->edges));
+	return r;
+}
+
+void jitter_free(struct jitter *jitter)
+{
+	g_free(jitter->edges);
+	g_free(jitter);
+}
+
+static void add_edge(struct edge_stats *e, gint position)
+{
+	gdouble delta;
+
+	if (e->count == 0) {
+		e->reference = position;
+		e->min = position;
+		e->max = position;
+	}
+	e->count++;
+	delta = position - e->mean;
+	e->mean += delta / e->count;
+	e->m2 += delta * (position - e->mean);
+	e->min = MIN(e->min, position);
+	e->max = MAX(e->max, position);
+	e->histogram[CLAMP(position - e->reference + JITTER_RANGE,
+			   0, 2 * JITTER_RANGE)]++;
+}
+
+void jitter_add(struct jitter *jitter, struct capture *capture)
+{
+	gint n = jitter->noof_edges;
+	gint first, hi;
+
+	/* The first change at or after the trigger */
+	for (first = 0, hi = capture->noof_changes; first < hi;) {
+		gint mid = (first + hi) / 2;
+
+		if (capture->changes[mid].sample < capture->trigger)
+			first = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (gint s = 0; s < jitter->state->noof_signals; s++) {
+		struct signal_def *signal = &jitter->state->signals[s];
+		struct edge_stats *e = &jitter->edges[s * 2 * n];
+		gint seen = 0;
+
+		for (gint c = first - 1; c >= 0 && seen < n; c--)
+			if (capture->changes[c].diff & signal->mask)
+				add_edge(&e[n - 1 - seen++],
+					 capture->changes[c].sample
+					 - capture->trigger);
+		seen = 0;
+		for (gint c = first; c < capture->noof_changes && seen < n; c++)
+			if (capture->changes[c].diff & signal->mask)
+				add_edge(&e[n + seen++],
+					 capture->changes[c].sample
+					 - capture->trigger);
+	}
+	jitter->captures++;
+}
+
+void jitter_add_missed(struct jitter *jitter)
+{
+	jitter->missed++;
+}
+
+static void write_edge(struct output *out, struct edge_stats *e, gint edge)
+{
+	gint lo = 0, hi = 2 * JITTER_RANGE;
+
+	output_printf(out, "{\"edge\": %d, \"count\": %d", edge, e->count);
+	if (e->count == 0) {
+		output_putc(out, '}');
+		return;
+	}
+	output_printf(out, ", \"mean\": %.6g, \"std_dev\": ", e->mean);
+	if (e->count > 1)
+		output_printf(out, "%.6g", sqrt(e->m2 / (e->count - 1)));
+	else
+		output_printf(out, "null");
+	output_printf(out, ", \"min\": %d, \"max\": %d, \"peak_to_peak\": %d",
+		      e->min, e->max, e->max - e->min);
+
+	while (e->histogram[lo] == 0)
+		lo++;
+	while (e->histogram[hi] == 0)
+		hi--;
+	output_printf(out, ", \"histogram_start\": %d, \"histogram\": [",
+		      e->reference - JITTER_RANGE + lo);
+	for (gint b = lo; b <= hi; b++)
+		output_printf(out, "%s%d", b > lo ? ", " : "",
+			      e->histogram[b]);
+	output_printf(out, "]}");
+}
+
+gboolean jitter_dump(struct jitter *jitter)
+{
+	struct state *state = jitter->state;
+	struct output *out = output_open(state->outfile, state->compress, 0);
+	gint n = jitter->noof_edges;
+
+	if (out == NULL)
+		return FALSE;
+
+	output_printf(out, "{\"sample_rate\": %ld, \"captures\": %d, "
+		      "\"missed\": %d, \"signals\": {",
+		      state->sample_rate, jitter->captures, jitter->missed);
+	for (gint s = 0; s < state->noof_signals; s++) {
+		struct signal_def *signal = &state->signals[s];
+
+		output_printf(out, "\n  ");
+		stats_write_string(out, signal->name);
+		output_printf(out, ": [");
+		for (gint e = 0; e < 2 * n; e++) {
+			output_printf(out, "\n    ");
+			write_edge(out, &jitter->edges[s * 2 * n + e], e - n);
+			if (e + 1 < 2 * n)
+				output_putc(out, ',');
+		}
+		output_printf(out, "]");
+		if (s + 1 < state->noof_signals)
+			output_putc(out, ',');
+	}
+	output_printf(out, "\n}}\n");
+	return output_close(out);
+}
@@ -0,0 +1,52 @@
+/* -*- linux-c -*-
+ *
+ * Edge timing jitter over repeated captures
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _JITTER_H_
+#define _JITTER_H_
+
+#include "state.h"
+#include "capture.h"
+
+/* Histogram bins on each side of the reference position of an edge */
+#define JITTER_RANGE 16
+
+struct jitter;
+
+struct jitter *jitter_new(struct state *state);
+
+void jitter_free(struct jitter *jitter);
+
+/*
+ * Accumulate the positions relative to the trigger point of the edges
+ * closest to the trigger of every signal. The capture is not
+ * referenced afterwards.
+ */
+void jitter_add(struct jitter *jitter, struct capture *capture);
+
+/* Count a capture which could not be aligned */
+void jitter_add_missed(struct jitter *jitter);
+
+/* Write the report as JSON to the output file */
+gboolean jitter_dump(struct jitter *jitter);
+
+#endif /* _JITTER_H_ */
@@ -0,0 +1,249 @@
+/* -*- linux-c -*-
+ *
+ * Live terminal display
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "live.h"
+
+#define DEFAULT_COLUMNS 80
+#define STATUS_ROWS 2 /* The status line and the trigger marker */
+
+struct live {
+	struct state *state;
+	gint columns;
+	gint name_width;
+	GPtrArray *rows; /* The text of each row on the terminal */
+	gint captures;
+	gint missed;
+	gint samples; /* In the last capture drawn */
+	/* For the captures per second */
+	gint64 since;
+	gint captures_since;
+	gdouble rate;
+};
+
+static const gchar restore[] = "\033[?25h\n";
+
+static void restore_terminal(void)
+{
+	fputs(restore, stdout);
+	fflush(stdout);
+}
+
+static void interrupted(int sig)
+{
+	/* The device may be armed, but is reset on the next start */
+	if (write(STDOUT_FILENO, restore, sizeof(restore) - 1) < 0)
+		_exit(1);
+	_exit(0);
+}
+
+struct live *live_new(struct state *state)
+{
+	struct live *r = g_malloc0(sizeof(*r));
+
+	r->state = state;
+	r->rows = g_ptr_array_new_with_free_func(g_free);
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+
+		r->name_width = MAX(r->name_width, (gint)strlen(s->name));
+	}
+	r->since = g_get_monotonic_time();
+
+	/* The screen is cleared by the first draw */
+	printf("\033[?25l");
+	atexit(restore_terminal);
+	signal(SIGINT, interrupted);
+	signal(SIGTERM, interrupted);
+	return r;
+}
+
+void live_free(struct live *live)
+{
+	g_ptr_array_free(live->rows, TRUE);
+	g_free(live);
+}
+
+static gint terminal_columns(void)
+{
+	struct winsize ws;
+
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+		return ws.ws_col;
+	return DEFAULT_COLUMNS;
+}
+
+/* The number of changes of signal in [start, end) */
+static gint count_changes(struct capture *capture, struct signal_def *signal,
+			  gint start, gint end)
+{
+	gint changes = 0;
+
+	if (signal->noof_bits == 1) {
+		gint channel = signal->channels[0];
+
+		return capture_find_edge(capture, channel, end)
+			- capture_find_edge(capture, channel, start);
+	}
+	for (gint i = MAX(start, 1); i < end; i++)
+		if ((capture->samples[i] ^ capture->samples[i - 1])
+		    & signal->mask)
+			changes++;
+	return changes;
+}
+
+/*
+ * A one bit signal is drawn as '_' and '-' for low and high, '/' and
+ * '\' for a single edge within a column and '|' for several. Wider
+ * signals are drawn as '=' and 'X' for columns with changes, followed
+ * by the value at the trigger point.
+ */
+static gchar *render_signal(struct live *live, struct capture *capture,
+			    struct signal_def *signal, gint width)
+{
+	GString *row = g_string_new(NULL);
+	gint n = capture->noof_samples;
+
+	g_string_printf(row, "%-*s ", live->name_width, signal->name);
+	for (gint c = 0; c < width; c++) {
+		gint start = (gint64)c * n / width;
+		gint end = MAX((gint64)(c + 1) * n / width, start + 1);
+		gint changes = count_changes(capture, signal, start, end);
+		guint32 v = capture_signal_value(signal,
+						 capture->samples[end - 1]);
+
+		if (signal->noof_bits != 1)
+			g_string_append_c(row, changes ? 'X' : '=');
+		else if (changes > 1)
+			g_string_append_c(row, '|');
+		else if (changes == 1)
+			g_string_append_c(row, v ? '/' : '\\');
+		else
+			g_string_append_c(row, v ? '-' : '_');
+	}
+	if (signal->noof_bits != 1 && capture->trigger < n)
+		g_string_append_printf(
+			row, " %x", capture_signal_value(
+				signal, capture->samples[capture->trigger]));
+	return g_string_free(row, FALSE);
+}
+
+/*
+ * Write the row if it differs from what is on the terminal, cut at
+ * the width of the terminal so it does not wrap
+ */
+static void update_row(struct live *live, guint index, gchar *text)
+{
+	if (strlen(text) > (gsize)live->columns)
+		text[live->columns] = 0;
+	if (index < live->rows->len
+	    && strcmp(g_ptr_array_index(live->rows, index), text) == 0) {
+		g_free(text);
+		return;
+	}
+	printf("\033[%u;1H%s\033[K", index + 1, text);
+	if (index >= live->rows->len)
+		g_ptr_array_add(live->rows, text);
+	else {
+		g_free(g_ptr_array_index(live->rows, index));
+		g_ptr_array_index(live->rows, index) = text;
+	}
+}
+
+static void update_rate(struct live *live)
+{
+	gint64 now = g_get_monotonic_time();
+
+	live->captures_since++;
+	if (now - live->since >= G_USEC_PER_SEC / 2) {
+		live->rate = live->captures_since * (gdouble)G_USEC_PER_SEC
+			/ (now - live->since);
+		live->since = now;
+		live->captures_since = 0;
+	}
+}
+
+/* Return the width of the terminal, clearing it if it has changed */
+static gint update_columns(struct live *live)
+{
+	gint columns = terminal_columns();
+
+	/* Everything moves when the terminal is resized */
+	if (columns != live->columns) {
+		printf("\033[2J");
+		g_ptr_array_set_size(live->rows, 0);
+		live->columns = columns;
+	}
+	return columns;
+}
+
+static void update_status(struct live *live)
+{
+	update_row(live, 0, g_strdup_printf(
+			   "%d captures, %.1f/s, %d missed, %d samples "
+			   "at %ld Hz", live->captures, live->rate,
+			   live->missed, live->samples,
+			   live->state->sample_rate));
+}
+
+void live_missed(struct live *live)
+{
+	live->missed++;
+	update_rate(live);
+	update_columns(live);
+	update_status(live);
+	fflush(stdout);
+}
+
+void live_draw(struct live *live, struct capture *capture)
+{
+	struct state *state = live->state;
+	gint columns = update_columns(live);
+	/* Leave room for the name and the value at the trigger point */
+	gint width = MAX(columns - live->name_width - 1
+			 - (1 + (MAX_SIGNAL_BITS + 3) / 4), 1);
+	gint n = capture->noof_samples;
+	guint index = STATUS_ROWS;
+	gchar *marker;
+
+	live->captures++;
+	live->samples = n;
+	update_rate(live);
+	update_status(live);
+
+	marker = g_strnfill(live->name_width + 1 + width, ' ');
+	if (n > 0 && capture->trigger < n)
+		marker[live->name_width + 1
+		       + (gint64)capture->trigger * width / n] = 'T';
+	update_row(live, 1, marker);
+
+	for (gint i = 0; i < state->noof_signals; i++)
+		update_row(live, index++,
+			   render_signal(live, capture, &state->signals[i],
+					 width));
+	fflush(stdout);
+}
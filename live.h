@@ -0,0 +1,47 @@
+/* -*- linux-c -*-
+ *
+ * Live terminal display
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _LIVE_H_
+#define _LIVE_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+struct live;
+
+/* Take over the terminal, it is restored on exit */
+struct live *live_new(struct state *state);
+
+void live_free(struct live *live);
+
+/*
+ * Show the capture as one text waveform per signal. Only the rows
+ * which differ from the previous capture are written to the terminal.
+ */
+void live_draw(struct live *live, struct capture *capture);
+
+/* Count a capture in which the software trigger did not fire */
+void live_missed(struct live *live);
+
+#endif /* _LIVE_H_ */
@@ -20,187 +20,305 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib-object.h>
-#include "sump.h"
-#include "serial.h"
 #include "state.h"
 #include "cmdline.h"
+#include "capture.h"
+#include "device.h"
 #include "vcd.h"
-#include "trigger.h"
+#include "fst.h"
+#include "sigrok.h"
+#include "npy.h"
+#include "pyramid.h"
+#include "soft_trigger.h"
+#include "stats.h"
+#include "decode.h"
+#include "capfile.h"
+#include "compare.h"
+#include "archive.h"
+#include "jitter.h"
+#include "live.h"
+#include "trigger_sim.h"
+#include "profile.h"
+#include "plan.h"
 
-static gboolean setup_hardware(int port, struct state *state)
+static guint8 *do_capture(struct state *state)
 {
-	gboolean success = FALSE;
-	guint32 ident;
+	guint8 *buffer = NULL;
+	gint port = device_open(state);
 
-	if (!sump_drain_input(port)) {
-		fprintf(stderr, "Failed to drain input\n");
-		goto error;
+	if (port == -1)
+		return NULL;
+
+	/* Probe only once, the captures of --jitter must share a rate */
+	if (state->auto_rate) {
+		if (!device_choose_sample_rate(port, state))
+			goto error;
+		state->auto_rate = FALSE;
 	}
+	buffer = device_capture(port, state);
+error:
+	close(port);
+	return buffer;
+}
 
-	if (!sump_cmd_reset(port)) {
-		fprintf(stderr, "Reset failed\n");
-		goto error;
+static gboolean write_output(struct state *state, struct capture *capture)
+{
+	if (state->stats)
+		return stats_dump(state, capture);
+
+	switch (state->format) {
+	case FORMAT_FST:
+		return fst_dump(state, capture);
+	case FORMAT_SIGROK:
+		return sigrok_dump(state, capture);
+	case FORMAT_NPY:
+		return npy_dump(state, capture);
+	case FORMAT_CAPTURE:
+		return capfile_save(state, capture);
+	case FORMAT_VCD:
+	default:
+		return vcd_dump(state, capture);
 	}
+}
 
-	if (!sump_cmd_id(port, &ident)) {
-		fprintf(stderr, "Ident failed\n");
-		goto error;
+/*
+ * Return capture number n, read from the input files or captured
+ * from the device.
+ */
+static struct capture *obtain_capture(struct state *state, gint n)
+{
+	struct capture *capture;
+	guint8 *samples;
+	glong sample_rate;
+
+	if (state->input_files != NULL) {
+		profile_begin(PROFILE_CONVERT);
+		capture = capfile_load(state, state->input_files[n],
+				       &sample_rate);
+		profile_end(PROFILE_CONVERT);
+		if (capture == NULL) {
+			fprintf(stderr, "Failed to read capture\n");
+			return NULL;
+		}
+		if (n > 0 && sample_rate != state->sample_rate) {
+			fprintf(stderr, "%s: Captured at %ld Hz, not at %ld "
+				"Hz as the first input file\n",
+				state->input_files[n], sample_rate,
+				state->sample_rate);
+			capture_free(capture);
+			return NULL;
+		}
+		state->sample_rate = sample_rate;
+		return capture;
 	}
-	if (ident != 0x534c4131) {
-		fprintf(stderr, "Ident failed, device returned 0x%x\n", ident);
-		goto error;
+
+	samples = do_capture(state);
+	if (samples == NULL) {
+		fprintf(stderr, "Failed to obtain capture\n");
+		return NULL;
 	}
-	success = TRUE;
-error:
-	return success;
+	profile_begin(PROFILE_CONVERT);
+	capture = capture_new(state, samples);
+	profile_end(PROFILE_CONVERT);
+	g_free(samples);
+	return capture;
 }
 
-static gboolean setup_triggers(int port, struct state *state)
+/*
+ * Accumulate the edge jitter over all input files or a number of
+ * captures from the device, keeping one capture at a time. first is
+ * the first capture if it has already been obtained.
+ */
+static gboolean analyse_jitter(struct state *state,
+			       struct soft_trigger *soft_trigger,
+			       struct capture *first)
 {
+	struct jitter *jitter = jitter_new(state);
+	gint noof_captures = state->input_files != NULL
+		? g_strv_length(state->input_files) : state->repeat;
 	gboolean success = FALSE;
-	if (!trigger_compile(state))
-		goto error;
-	for (gint i = 0; i < NOOF_TRIGGERS; i++)
-		if (!sump_cmd_set_trigger(port, state->triggers + i)) {
-			fprintf(stderr, "Failed to set up trigger\n");
+
+	for (gint n = 0; n < noof_captures; n++) {
+		struct capture *capture = n == 0 ? first : NULL;
+
+		if (capture == NULL
+		    && (capture = obtain_capture(state, n)) == NULL)
+			goto error;
+		/* A capture where the software trigger did not fire */
+		if (soft_trigger != NULL
+		    && !soft_trigger_apply(soft_trigger, capture))
+			jitter_add_missed(jitter);
+		else
+			jitter_add(jitter, capture);
+		if (!profile_report(state, capture)) {
+			capture_free(capture);
 			goto error;
 		}
-	success = TRUE;
+		capture_free(capture);
+	}
+	success = jitter_dump(jitter);
+	if (!success)
+		fprintf(stderr, "Failed to write jitter report\n");
 error:
+	jitter_free(jitter);
 	return success;
 }
 
-static gboolean setup_capture(int port, struct state *state)
+/*
+ * Capture and display continuously until interrupted or the device
+ * stops answering, the device is kept open and re-armed as soon as a
+ * buffer has been read. Return FALSE if nothing could be captured.
+ */
+static gboolean run_live(struct state *state,
+			 struct soft_trigger *soft_trigger)
 {
+	gint port = device_open(state);
+	struct live *live;
 	gboolean success = FALSE;
-	guint32 divider, flags = 0;
-	guint32 buffer_capacity;
-
-	if (state->sample_rate > CLOCK_FREQ &&
-	    state_noof_channel_groups_in_use(state) > 2) {
-		fprintf(stderr,
-			"Cannot handle clock frequency of %ld when %d "
-			"channel groups are used.\n",
-			state->sample_rate,
-			state_noof_channel_groups_in_use(state));
-		goto error;
-	}
 
-	if (state->sample_rate > CLOCK_FREQ)
-		divider = (2 * CLOCK_FREQ / state->sample_rate) - 1;
-	else
-		divider = (CLOCK_FREQ / state->sample_rate) - 1;
-	if (!sump_cmd_set_divider(port, divider)) {
-		fprintf(stderr, "Failed to set divider\n");
+	if (port == -1)
+		return FALSE;
+	if (state->auto_rate && !device_choose_sample_rate(port, state))
 		goto error;
-	}
-	if (state->sample_rate > CLOCK_FREQ) {
-		flags |= SUMP_FLAG_DEMUX;
-	}
-	if ((flags & SUMP_FLAG_DEMUX) && state->filter) {
-		fprintf(stderr,
-			"Cannot use the filter at the current sample rate\n");
-		goto error;
-	}
-	if (state->filter)
-		flags |= SUMP_FLAG_FILTER;
-	if (state->external_clock)
-		flags |= SUMP_FLAG_EXTERNAL_CLOCK;
-	if (state->external_invert)
-		flags |= SUMP_FLAG_INVERT_EXTERNAL_CLOCK;
-	if ((state->channels_in_use & 0x000000FF) == 0)
-		flags |= SUMP_FLAG_CHANNEL_GROUP_0_DISABLED;
-	if ((state->channels_in_use & 0x0000FF00) == 0)
-		flags |= SUMP_FLAG_CHANNEL_GROUP_1_DISABLED;
-	if ((state->channels_in_use & 0x00FF0000) == 0)
-		flags |= SUMP_FLAG_CHANNEL_GROUP_2_DISABLED;
-	if ((state->channels_in_use & 0xFF000000) == 0)
-		flags |= SUMP_FLAG_CHANNEL_GROUP_3_DISABLED;
-
-	if (!sump_cmd_set_flags(port, flags)) {
-		fprintf(stderr, "Failed to set flags\n");
-		goto error;
-	}
 
-	if (!setup_triggers(port, state)) {
-		fprintf(stderr, "Failed to set up triggers\n");
-		goto error;
-	}
+	live = live_new(state);
+	for (;;) {
+		guint8 *samples = device_capture(port, state);
+		struct capture *capture;
 
-	buffer_capacity = state_buffer_capacity(state);
-	if (!sump_cmd_set_size(
-		    port, (buffer_capacity >> 2) - 1,
-		    ((buffer_capacity - state->trigger_holdoff) >> 2) - 1)) {
-	 	fprintf(stderr, "Failed to set size\n");
-		goto error;
+		/* The device going away ends the display */
+		if (samples == NULL)
+			break;
+		profile_begin(PROFILE_CONVERT);
+		capture = capture_new(state, samples);
+		profile_end(PROFILE_CONVERT);
+		g_free(samples);
+		profile_begin(PROFILE_OUTPUT);
+		if (soft_trigger != NULL
+		    && !soft_trigger_apply(soft_trigger, capture))
+			live_missed(live);
+		else
+			live_draw(live, capture);
+		profile_end(PROFILE_OUTPUT);
+		success = profile_report(state, capture);
+		capture_free(capture);
+		if (!success)
+			break;
 	}
-
-	success = TRUE;
+	live_free(live);
 error:
+	close(port);
 	return success;
 }
 
-static guint8 *do_capture(struct state *state)
+gint main(int argc, gchar *argv[])
 {
-	guint8 *buffer = NULL;
-	gint port;
-	guint32 buffer_size;
+	struct state state;
+	struct capture *capture = NULL;
+	struct soft_trigger *soft_trigger = NULL;
+	struct decode *decode = NULL;
+	struct compare *compare = NULL;
+	gboolean match = TRUE;
+
+	setup_configuration(argc, argv, &state);
+	output_set_policy(state.write_policy);
+	if (state.stats_json != NULL && !profile_open(state.stats_json))
+		exit(1);
 
-	port = open_serial(state->device, state->baudrate);
+	if (state.queries != NULL)
+		return archive_query(&state) ? 0 : 1;
+	if (state.plan)
+		return plan_print(&state) ? 0 : 1;
 
-	if (port == -1) {
-		perror("open_serial");
-		return NULL;
+	/* The sample rate of the input is needed for the set up below */
+	if (state.input_files != NULL) {
+		capture = obtain_capture(&state, 0);
+		if (capture == NULL)
+			exit(1);
 	}
 
-	if (!setup_hardware(port, state)) {
-		fprintf(stderr, "Failed to set up hardware\n");
-		goto error;
-	}
+	if (state.simulate_trigger) {
+		gboolean fired;
 
-	if (!setup_capture(port, state)) {
-		fprintf(stderr, "Failed to set up capture\n");
-		goto error;
+		if (capture == NULL)
+			capture = trigger_sim_synthetic(&state);
+		if (!trigger_sim_run(&state, capture, &fired))
+			exit(1);
+		return fired ? 0 : 2;
 	}
 
-	if (!sump_cmd_run(port)) {
-		fprintf(stderr, "Failed to run\n");
-		goto error;
+	/* Check the software trigger before waiting for the capture */
+	if (state.soft_trigger_spec != NULL) {
+		soft_trigger = soft_trigger_compile(&state);
+		if (soft_trigger == NULL) {
+			fprintf(stderr, "Failed to set up software trigger\n");
+			exit(1);
+		}
+	}
+	if (state.decoders != NULL) {
+		decode = decode_setup(&state);
+		if (decode == NULL) {
+			fprintf(stderr, "Failed to set up decoders\n");
+			exit(1);
+		}
+	}
+	if (state.compare_file != NULL) {
+		compare = compare_setup(&state);
+		if (compare == NULL) {
+			fprintf(stderr, "Failed to set up comparison\n");
+			exit(1);
+		}
 	}
 
-	buffer_size = state_buffer_capacity(state)
-		* state_noof_channel_groups_in_use(state);
-	buffer = g_malloc(buffer_size);
+	if (state.jitter)
+		return analyse_jitter(&state, soft_trigger, capture) ? 0 : 1;
+	if (state.live)
+		return run_live(&state, soft_trigger) ? 0 : 1;
 
-	if (!sump_read_buffer(port, buffer_size, buffer, -1)) {
-		fprintf(stderr, "Failed to read result\n");
-		g_free(buffer);
-		goto error;
-	}
-	return buffer;
-error:
-	close(port);
-	return NULL;
-}
+	if (capture == NULL && (capture = obtain_capture(&state, 0)) == NULL)
+		exit(1);
 
-gint main(int argc, gchar *argv[])
-{
-	struct state state;
-	guint8 *samples;
+	if (soft_trigger != NULL) {
+		if (!soft_trigger_apply(soft_trigger, capture))
+			exit(1);
+		soft_trigger_free(soft_trigger);
+	}
 
-	setup_configuration(argc, argv, &state);
+	/* The comparison report goes to stdout, the capture only to a file */
+	if (compare != NULL) {
+		if (!compare_run(compare, capture, &match))
+			exit(1);
+		compare_free(compare);
+	}
 
-	samples = do_capture(&state);
-	if (samples == NULL) {
-		fprintf(stderr, "Failed to obtain capture\n");
+	profile_begin(PROFILE_OUTPUT);
+	if ((state.compare_file == NULL || state.outfile != NULL)
+	    && !write_output(&state, capture)) {
+		fprintf(stderr, "Failed to write capture\n");
 		exit(1);
 	}
-	if (!vcd_dump(&state, samples)) {
-		fprintf(stderr, "Failed to dump capture to VCD\n");
+	if (state.archive_dir != NULL && !archive_store(&state, capture)) {
+		fprintf(stderr, "Failed to store capture in the archive\n");
 		exit(1);
 	}
+	if (state.pyramid && !pyramid_dump(&state, capture)) {
+		fprintf(stderr, "Failed to write summary pyramid\n");
+		exit(1);
+	}
+	if (decode != NULL) {
+		if (!decode_run(decode, capture)) {
+			fprintf(stderr, "Failed to write decoded data\n");
+			exit(1);
+		}
+		decode_free(decode);
+	}
+	profile_end(PROFILE_OUTPUT);
+	if (!profile_report(&state, capture))
+		exit(1);
 
-	return 0;
+	/* Let scripts tell a diverging capture from a failure */
+	return match ? 0 : 2;
 }
@@ -0,0 +1,149 @@
+/* -*- linux-c -*-
+ *
+ * NumPy array (.npy) writer
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "npy.h"
+#include "output.h"
+
+#define NPY_ALIGNMENT 64
+
+gboolean npy_write(gchar *filename, gchar type, gint element_size,
+		   gint noof_elements, const void *data)
+{
+	struct output *out;
+	GString *header = g_string_new(NULL);
+	guint8 preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, 0, 0 };
+	gchar endian = G_BYTE_ORDER == G_LITTLE_ENDIAN ? '<' : '>';
+	gsize header_len;
+
+	if (element_size == 1)
+		endian = '|';
+	g_string_printf(header,
+			"{'descr': '%c%c%d', 'fortran_order': False, ",
+			endian, type, element_size);
+	if (noof_elements < 0)
+		g_string_append(header, "'shape': (), }");
+	else
+		g_string_append_printf(header, "'shape': (%d,), }",
+				       noof_elements);
+	/* Pad with spaces and a final newline to align the data */
+	while ((sizeof(preamble) + header->len + 1) % NPY_ALIGNMENT)
+		g_string_append_c(header, ' ');
+	g_string_append_c(header, '\n');
+
+	header_len = header->len;
+	preamble[8] = header_len & 0xff;
+	preamble[9] = header_len >> 8;
+
+	out = output_open(filename, FALSE,
+			  sizeof(preamble) + header->len
+			  + (gsize)element_size * MAX(noof_elements, 1));
+	if (out == NULL) {
+		g_string_free(header, TRUE);
+		return FALSE;
+	}
+	output_write(out, preamble, sizeof(preamble));
+	output_write(out, header->str, header->len);
+	output_write(out, data, (gsize)element_size * MAX(noof_elements, 1));
+	g_string_free(header, TRUE);
+	return output_close(out);
+}
+
+gint npy_element_size(gint noof_bits)
+{
+	if (noof_bits <= 8)
+		return 1;
+	if (noof_bits <= 16)
+		return 2;
+	return 4;
+}
+
+void *npy_signal_column(struct capture *capture, struct signal_def *signal,
+			gint element_size)
+{
+	void *column = g_malloc((gsize)capture->noof_samples * element_size);
+
+	for (gint i = 0; i < capture->noof_samples; i++) {
+		guint32 v = capture_signal_value(signal, capture->samples[i]);
+
+		switch (element_size) {
+		case 1:
+			((guint8 *)column)[i] = v;
+			break;
+		case 2:
+			((guint16 *)column)[i] = v;
+			break;
+		default:
+			((guint32 *)column)[i] = v;
+			break;
+		}
+	}
+	return column;
+}
+
+gboolean npy_dump(struct state *state, struct capture *capture)
+{
+	gchar *prefix, *filename;
+	gdouble *time;
+	gint64 trigger = capture->trigger;
+	gboolean success = TRUE;
+
+	if (state->outfile == NULL) {
+		fprintf(stderr, "NumPy output cannot be written to stdout\n");
+		return FALSE;
+	}
+	if (g_str_has_suffix(state->outfile, ".npy"))
+		prefix = g_strndup(state->outfile,
+				   strlen(state->outfile) - strlen(".npy"));
+	else
+		prefix = g_strdup(state->outfile);
+
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+		gint size = npy_element_size(s->noof_bits);
+		void *column = npy_signal_column(capture, s, size);
+
+		filename = g_strdup_printf("%s.%s.npy", prefix, s->name);
+		success = npy_write(filename, 'u', size,
+				    capture->noof_samples, column) && success;
+		g_free(filename);
+		g_free(column);
+	}
+
+	time = g_malloc(capture->noof_samples * sizeof(*time));
+	for (gint i = 0; i < capture->noof_samples; i++)
+		time[i] = (gdouble)(i - capture->trigger) / state->sample_rate;
+	filename = g_strdup_printf("%s.time.npy", prefix);
+	success = npy_write(filename, 'f', sizeof(*time),
+			    capture->noof_samples, time) && success;
+	g_free(filename);
+	g_free(time);
+
+	filename = g_strdup_printf("%s.trigger.npy", prefix);
+	success = npy_write(filename, 'i', sizeof(trigger), -1, &trigger)
+		&& success;
+	g_free(filename);
+
+	g_free(prefix);
+	return success;
+}
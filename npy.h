@@ -0,0 +1,53 @@
+/* -*- linux-c -*-
+ *
+ * NumPy array (.npy) writer
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _NPY_H_
+#define _NPY_H_
+
+#include "state.h"
+#include "capture.h"
+
+/*
+ * Write one file per signal named <prefix>.<signal>.npy together with
+ * <prefix>.time.npy and <prefix>.trigger.npy. The prefix is the output
+ * filename with any .npy suffix removed.
+ */
+gboolean npy_dump(struct state *state, struct capture *capture);
+
+/*
+ * Write a one dimensional array of native endian elements, or a
+ * scalar if noof_elements is -1. type is the NumPy type character
+ * ('u', 'i' or 'f'). The data starts on a 64 byte boundary so the
+ * file can be memory mapped.
+ */
+gboolean npy_write(gchar *filename, gchar type, gint element_size,
+		   gint noof_elements, const void *data);
+
+/* The smallest unsigned element size in bytes holding noof_bits */
+gint npy_element_size(gint noof_bits);
+
+/* Return a newly allocated array with the value of signal per sample */
+void *npy_signal_column(struct capture *capture, struct signal_def *signal,
+			gint element_size);
+
+#endif /* _NPY_H_ */
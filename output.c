@@ -0,0 +1,437 @@
+/* -*- linux-c -*-
+ *
+ * Buffered output with optional gzip compression
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "output.h"
+#include "profile.h"
+#include "probes.h"
+
+static enum output_policy policy = OUTPUT_POLICY_BUFFERED;
+
+struct output_buffer {
+	gchar *data;
+	gsize used;
+};
+
+/*
+ * The formatter fills 'current'. When it is full it is handed to the
+ * writer thread through 'pending' and the formatter continues in the
+ * other buffer. A buffer is only reused once the writer has cleared
+ * 'pending', so at most one buffer is in flight at any time and the
+ * formatter only waits if the file system is slower than it is.
+ */
+struct output {
+	gint fd;
+	gchar *filename;
+	gboolean failed;
+
+	struct output_buffer buffers[2];
+	struct output_buffer *current;
+
+	GThread *writer;
+	GMutex lock;
+	GCond cond;
+	struct output_buffer *pending;
+	gboolean done;
+
+	/* Only touched by the writer thread */
+	gboolean compress;
+	z_stream stream;
+	gboolean regular_file;
+	enum output_policy policy;
+	gsize preallocated;
+	off_t written;
+	off_t synced;
+	off_t previous_synced; /* Start of the range synced last */
+	/*
+	 * With O_DIRECT all writes must be aligned. Data which is not
+	 * a multiple of the alignment is collected in 'staging'.
+	 */
+	struct output_buffer staging;
+};
+
+void output_set_policy(enum output_policy p)
+{
+	policy = p;
+}
+
+static gboolean write_all(struct output *out, const guint8 *data, gsize size)
+{
+	while (size > 0) {
+		ssize_t r = write(out->fd, data, size);
+
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			perror(out->filename);
+			return FALSE;
+		}
+		size -= r;
+		data += r;
+		out->written += r;
+	}
+	return TRUE;
+}
+
+/*
+ * Start write-back of what has been written since the last call and
+ * wait for the previous range to hit the disk, then drop it from the
+ * page cache. This keeps the amount of dirty data bounded so that the
+ * kernel does not throttle us in one large stall.
+ */
+static void sync_written(struct output *out)
+{
+	off_t length = out->written - out->synced;
+
+	if (length == 0)
+		return;
+	sync_file_range(out->fd, out->synced, length,
+			SYNC_FILE_RANGE_WRITE);
+	if (out->synced > out->previous_synced) {
+		sync_file_range(out->fd, out->previous_synced,
+				out->synced - out->previous_synced,
+				SYNC_FILE_RANGE_WAIT_BEFORE
+				| SYNC_FILE_RANGE_WRITE
+				| SYNC_FILE_RANGE_WAIT_AFTER);
+		posix_fadvise(out->fd, out->previous_synced,
+			      out->synced - out->previous_synced,
+			      POSIX_FADV_DONTNEED);
+	}
+	out->previous_synced = out->synced;
+	out->synced = out->written;
+}
+
+static gboolean sink(struct output *out, const guint8 *data, gsize size)
+{
+	gboolean ok = TRUE;
+
+	if (out->policy != OUTPUT_POLICY_DIRECT) {
+		ok = write_all(out, data, size);
+		if (ok && out->policy == OUTPUT_POLICY_SYNC)
+			sync_written(out);
+		return ok;
+	}
+
+	/* Full aligned buffers are written as they are */
+	if (out->staging.used == 0 && size % OUTPUT_ALIGNMENT == 0
+	    && ((gsize)data % OUTPUT_ALIGNMENT) == 0)
+		return write_all(out, data, size);
+
+	while (ok && size > 0) {
+		gsize n = MIN(size, OUTPUT_BUFFER_SIZE - out->staging.used);
+
+		memcpy(out->staging.data + out->staging.used, data, n);
+		out->staging.used += n;
+		data += n;
+		size -= n;
+		if (out->staging.used == OUTPUT_BUFFER_SIZE) {
+			ok = write_all(out, (guint8 *)out->staging.data,
+				       OUTPUT_BUFFER_SIZE);
+			out->staging.used = 0;
+		}
+	}
+	return ok;
+}
+
+/* Write out what is left in the staging buffer and fix the size */
+static gboolean sink_finish(struct output *out)
+{
+	gboolean ok = TRUE;
+	off_t size;
+
+	if (out->staging.used > 0) {
+		gsize padded = (out->staging.used + OUTPUT_ALIGNMENT - 1)
+			& ~(OUTPUT_ALIGNMENT - 1);
+
+		memset(out->staging.data + out->staging.used, 0,
+		       padded - out->staging.used);
+		size = out->written + out->staging.used;
+		ok = write_all(out, (guint8 *)out->staging.data, padded);
+		out->written = size;
+	}
+	if (out->policy == OUTPUT_POLICY_SYNC)
+		sync_written(out);
+	/* Drop padding and any preallocated space which was not used */
+	if (out->regular_file
+	    && (out->staging.used > 0 || out->preallocated > out->written)
+	    && ftruncate(out->fd, out->written) == -1) {
+		perror(out->filename);
+		ok = FALSE;
+	}
+	return ok;
+}
+
+static gboolean deflate_data(struct output *out,
+			     const guint8 *data, gsize size, gint flush)
+{
+	guint8 chunk[64 * 1024];
+
+	out->stream.next_in = (Bytef *)data;
+	out->stream.avail_in = size;
+	do {
+		out->stream.next_out = chunk;
+		out->stream.avail_out = sizeof(chunk);
+		if (deflate(&out->stream, flush) == Z_STREAM_ERROR) {
+			fprintf(stderr, "%s: Compression failed\n",
+				out->filename);
+			return FALSE;
+		}
+		if (!sink(out, chunk, sizeof(chunk) - out->stream.avail_out))
+			return FALSE;
+	} while (out->stream.avail_out == 0);
+	return TRUE;
+}
+
+static gpointer writer_thread(gpointer data)
+{
+	struct output *out = data;
+	gboolean ok = TRUE;
+
+	while (TRUE) {
+		struct output_buffer *b;
+
+		g_mutex_lock(&out->lock);
+		while (out->pending == NULL && !out->done)
+			g_cond_wait(&out->cond, &out->lock);
+		b = out->pending;
+		g_mutex_unlock(&out->lock);
+
+		if (b == NULL)
+			break;
+
+		if (ok && out->compress)
+			ok = deflate_data(out, (guint8 *)b->data, b->used,
+					  Z_NO_FLUSH);
+		else if (ok)
+			ok = sink(out, (guint8 *)b->data, b->used);
+		g_mutex_lock(&out->lock);
+		b->used = 0;
+		out->pending = NULL;
+		g_cond_signal(&out->cond);
+		g_mutex_unlock(&out->lock);
+	}
+
+	if (ok && out->compress)
+		ok = deflate_data(out, NULL, 0, Z_FINISH);
+	if (ok)
+		ok = sink_finish(out);
+	return GINT_TO_POINTER(ok);
+}
+
+static void flush_current(struct output *out)
+{
+	struct output_buffer *b = out->current;
+
+	if (b->used == 0)
+		return;
+
+	/* The time in between is spent waiting for the writer thread */
+	PROBE2(output__flush__start, out->filename, b->used);
+	g_mutex_lock(&out->lock);
+	while (out->pending != NULL)
+		g_cond_wait(&out->cond, &out->lock);
+	out->pending = b;
+	g_cond_signal(&out->cond);
+	g_mutex_unlock(&out->lock);
+	PROBE2(output__flush__done, out->filename, b->used);
+
+	out->current = (b == &out->buffers[0])
+		? &out->buffers[1] : &out->buffers[0];
+}
+
+static gchar *aligned_buffer(void)
+{
+	void *p;
+
+	if (posix_memalign(&p, OUTPUT_ALIGNMENT, OUTPUT_BUFFER_SIZE) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	return p;
+}
+
+static gboolean open_file(struct output *out, gchar *filename)
+{
+	gint flags = O_WRONLY | O_CREAT | O_TRUNC;
+	struct stat st;
+
+	if (filename == NULL) {
+		out->fd = STDOUT_FILENO;
+		out->filename = g_strdup("stdout");
+	} else {
+		if (out->policy == OUTPUT_POLICY_DIRECT)
+			flags |= O_DIRECT;
+		out->fd = open(filename, flags, 0666);
+		if (out->fd == -1 && out->policy == OUTPUT_POLICY_DIRECT
+		    && errno == EINVAL) {
+			/* The file system does not support O_DIRECT */
+			out->policy = OUTPUT_POLICY_BUFFERED;
+			out->fd = open(filename, flags & ~O_DIRECT, 0666);
+		}
+		if (out->fd == -1) {
+			perror(filename);
+			return FALSE;
+		}
+		out->filename = g_strdup(filename);
+	}
+
+	/*
+	 * Stdout may be opened for appending or shared with others, so
+	 * only files opened here may be preallocated and truncated.
+	 */
+	out->regular_file = out->fd != STDOUT_FILENO
+		&& fstat(out->fd, &st) == 0 && S_ISREG(st.st_mode);
+	if (!out->regular_file)
+		out->policy = OUTPUT_POLICY_BUFFERED;
+	return TRUE;
+}
+
+struct output *output_open(gchar *filename, gboolean compress,
+			   gsize size_hint)
+{
+	struct output *out = g_malloc0(sizeof(*out));
+
+	out->policy = policy;
+	if (!open_file(out, filename)) {
+		g_free(out);
+		return NULL;
+	}
+
+	/*
+	 * Reserve the space up front so that the file system does not
+	 * have to allocate blocks piecemeal while we write. The size of
+	 * compressed output is not known so it is not preallocated.
+	 */
+	if (out->regular_file && size_hint > 0 && !compress
+	    && posix_fallocate(out->fd, 0, size_hint) == 0)
+		out->preallocated = size_hint;
+
+	out->compress = compress;
+	/* A window size of 15 + 16 gives a gzip header and trailer */
+	if (compress
+	    && deflateInit2(&out->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			    15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		fprintf(stderr, "%s: Failed to initialize compression\n",
+			out->filename);
+		if (out->fd != STDOUT_FILENO)
+			close(out->fd);
+		g_free(out->filename);
+		g_free(out);
+		return NULL;
+	}
+
+	out->buffers[0].data = aligned_buffer();
+	out->buffers[1].data = aligned_buffer();
+	if (out->policy == OUTPUT_POLICY_DIRECT)
+		out->staging.data = aligned_buffer();
+	out->current = &out->buffers[0];
+	g_mutex_init(&out->lock);
+	g_cond_init(&out->cond);
+	out->writer = g_thread_new("writer", writer_thread, out);
+	return out;
+}
+
+void output_write(struct output *out, const void *data, gsize size)
+{
+	const gchar *d = data;
+
+	while (size > 0) {
+		gsize n = MIN(size, OUTPUT_BUFFER_SIZE - out->current->used);
+
+		memcpy(out->current->data + out->current->used, d, n);
+		out->current->used += n;
+		d += n;
+		size -= n;
+		if (out->current->used == OUTPUT_BUFFER_SIZE)
+			flush_current(out);
+	}
+}
+
+void output_putc(struct output *out, gchar c)
+{
+	out->current->data[out->current->used++] = c;
+	if (out->current->used == OUTPUT_BUFFER_SIZE)
+		flush_current(out);
+}
+
+void output_printf(struct output *out, const gchar *format, ...)
+{
+	va_list args;
+	gsize room = OUTPUT_BUFFER_SIZE - out->current->used;
+	gint n;
+
+	va_start(args, format);
+	n = vsnprintf(out->current->data + out->current->used, room,
+		      format, args);
+	va_end(args);
+
+	if ((gsize)n < room) {
+		out->current->used += n;
+		return;
+	}
+
+	/* It did not fit, format it separately and copy it in */
+	va_start(args, format);
+	gchar *s = g_strdup_vprintf(format, args);
+	va_end(args);
+	output_write(out, s, n);
+	g_free(s);
+}
+
+gboolean output_close(struct output *out)
+{
+	gboolean ok;
+
+	flush_current(out);
+	g_mutex_lock(&out->lock);
+	out->done = TRUE;
+	g_cond_signal(&out->cond);
+	g_mutex_unlock(&out->lock);
+	if (!GPOINTER_TO_INT(g_thread_join(out->writer)))
+		out->failed = TRUE;
+	profile_count(PROFILE_WRITTEN, out->written);
+	g_mutex_clear(&out->lock);
+	g_cond_clear(&out->cond);
+	if (out->compress)
+		deflateEnd(&out->stream);
+
+	ok = !out->failed;
+	if (out->fd != STDOUT_FILENO && close(out->fd) == -1) {
+		perror(out->filename);
+		ok = FALSE;
+	}
+
+	free(out->buffers[0].data);
+	free(out->buffers[1].data);
+	free(out->staging.data);
+	g_free(out->filename);
+	g_free(out);
+	return ok;
+}
@@ -0,0 +1,68 @@
+/* -*- linux-c -*-
+ *
+ * Buffered output with optional gzip compression
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <glib.h>
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024) /* bytes */
+#define OUTPUT_ALIGNMENT 4096 /* bytes */
+
+enum output_policy {
+	/* Plain writes through the page cache */
+	OUTPUT_POLICY_BUFFERED,
+	/* Bypass the page cache with O_DIRECT */
+	OUTPUT_POLICY_DIRECT,
+	/* Start write-back of every buffer as soon as it is written */
+	OUTPUT_POLICY_SYNC
+};
+
+struct output;
+
+/* Select how files opened after the call are written */
+void output_set_policy(enum output_policy policy);
+
+/*
+ * Open filename for writing, stdout is used if filename is NULL. The
+ * data is written by a worker thread while the caller fills the next
+ * buffer, and is gzip compressed by the same thread if compress is
+ * set. size_hint is the expected size of the file, or 0 if unknown,
+ * and is used to preallocate the file.
+ *
+ * Return NULL on error.
+ */
+struct output *output_open(gchar *filename, gboolean compress,
+			   gsize size_hint);
+
+void output_write(struct output *out, const void *data, gsize size);
+
+void output_putc(struct output *out, gchar c);
+
+void output_printf(struct output *out, const gchar *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+/* Flush and close, return FALSE if any data could not be written */
+gboolean output_close(struct output *out);
+
+#endif /* _OUTPUT_H_ */
@@ -0,0 +1,272 @@
+/* -*- linux-c -*-
+ *
+ * Predicting the cost of a capture before arming
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include "plan.h"
+#include "device.h"
+#include "trigger.h"
+
+#define NOOF_GROUPS (NOOF_PHYSICAL_CHANNELS / 8)
+#define BITS_PER_BYTE 10 /* On the serial link, with start and stop bit */
+
+static glong link_rate(speed_t baudrate)
+{
+	switch (baudrate) {
+	case B57600:
+		return 57600;
+	case B38400:
+		return 38400;
+	case B19200:
+		return 19200;
+	default:
+		return 115200;
+	}
+}
+
+static void print_seconds(gdouble t)
+{
+	if (t >= 1)
+		printf("%.4g s", t);
+	else if (t >= 1e-3)
+		printf("%.4g ms", t * 1e3);
+	else if (t >= 1e-6)
+		printf("%.4g us", t * 1e6);
+	else
+		printf("%.4g ns", t * 1e9);
+}
+
+static gint noof_groups(guint32 channels)
+{
+	gint n = 0;
+
+	for (gint g = 0; g < NOOF_GROUPS; g++)
+		if (channels & (0xFFU << (8 * g)))
+			n++;
+	return n;
+}
+
+/*
+ * Move the channels of the least used channel groups to free channels
+ * of the other groups, so that the channels in use fit in as few
+ * groups as possible. map[c] is the new channel of physical channel
+ * c. Return the new channels in use.
+ */
+static guint32 pack_channels(guint32 used, gint *map)
+{
+	gint groups[NOOF_GROUPS];
+	gint k = 0, needed;
+	guint32 kept = 0, packed;
+
+	for (gint c = 0; c < NOOF_PHYSICAL_CHANNELS; c++)
+		map[c] = c;
+	needed = (__builtin_popcount(used) + 7) / 8;
+
+	/* The groups in use, the least used first */
+	for (gint g = 0; g < NOOF_GROUPS; g++) {
+		gint count = __builtin_popcount(used & (0xFFU << (8 * g)));
+		gint i;
+
+		if (count == 0)
+			continue;
+		for (i = k++; i > 0 && __builtin_popcount(
+			     used & (0xFFU << (8 * groups[i - 1]))) > count;
+		     i--)
+			groups[i] = groups[i - 1];
+		groups[i] = g;
+	}
+	if (needed >= k)
+		return used;
+
+	for (gint i = k - needed; i < k; i++)
+		kept |= 0xFFU << (8 * groups[i]);
+	packed = used & kept;
+	for (gint c = 0, slot = 0; c < NOOF_PHYSICAL_CHANNELS; c++) {
+		if (!(used & (1U << c)) || (kept & (1U << c)))
+			continue;
+		while (!(kept & (1U << slot)) || (packed & (1U << slot)))
+			slot++;
+		map[c] = slot;
+		packed |= 1U << slot;
+	}
+	return packed;
+}
+
+/*
+ * Append the channel list of the signal with the channels moved as
+ * in map, in the same order as on the command line. Return FALSE if
+ * the signal is computed by an expression.
+ */
+static gboolean moved_channel_list(struct state *state,
+				   struct signal_def *signal, gint *map,
+				   GString *r)
+{
+	gint n = signal->noof_bits;
+	gint channels[MAX_SIGNAL_BITS];
+	gboolean inverted[MAX_SIGNAL_BITS];
+
+	for (gint i = 0; i < n; i++) {
+		gint c = signal->channels[i];
+
+		inverted[i] = c >= NOOF_PHYSICAL_CHANNELS;
+		if (inverted[i]) {
+			struct virtual_channel *v = &state->virtual_channels[
+				c - NOOF_PHYSICAL_CHANNELS];
+
+			if (v->op != VIRTUAL_NOT
+			    || v->a >= NOOF_PHYSICAL_CHANNELS)
+				return FALSE;
+			c = v->a;
+		}
+		channels[i] = map[c];
+	}
+
+	/* Runs of consecutive channels are written as spans */
+	for (gint i = 0, j; i < n; i = j + 1) {
+		gint step = i + 1 < n ? channels[i + 1] - channels[i] : 0;
+
+		for (j = i; j + 1 < n && (step == 1 || step == -1)
+			     && inverted[j + 1] == inverted[i]
+			     && channels[j + 1] - channels[j] == step; j++)
+			;
+		g_string_append_printf(r, "%s%s%d", i > 0 ? "," : "",
+				       inverted[i] ? "~" : "", channels[i]);
+		if (j > i)
+			g_string_append_printf(r, "-%d", channels[j]);
+	}
+	return TRUE;
+}
+
+static void print_packing(struct state *state, glong rate)
+{
+	gint map[NOOF_PHYSICAL_CHANNELS];
+	guint32 packed = pack_channels(state->channels_in_use, map);
+	gint before = noof_groups(state->channels_in_use);
+	gint after = noof_groups(packed);
+	gint depth = MEMORY_SIZE / after;
+	gboolean computed = FALSE;
+
+	if (after == before) {
+		printf("The channels in use cannot fit in fewer groups\n");
+		return;
+	}
+
+	printf("Moving channels to use %d channel group%s gives %d samples",
+	       after, after > 1 ? "s" : "", depth);
+	if (rate > 0) {
+		printf(" (");
+		print_seconds((gdouble)depth / rate);
+		printf(")");
+	}
+	if (before > 2 && after <= 2)
+		printf(" and allows %d Hz without the filter",
+		       2 * CLOCK_FREQ);
+	printf(":\n");
+
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *signal = &state->signals[i];
+		GString *list = g_string_new("");
+		gboolean moved = FALSE;
+
+		for (gint bit = 0; bit < signal->noof_bits; bit++) {
+			gint c = signal->channels[bit];
+
+			if (c >= NOOF_PHYSICAL_CHANNELS)
+				c = state->virtual_channels[
+					c - NOOF_PHYSICAL_CHANNELS].a;
+			if (c < NOOF_PHYSICAL_CHANNELS && map[c] != c)
+				moved = TRUE;
+		}
+		if (!moved_channel_list(state, signal, map, list))
+			computed = TRUE;
+		else if (moved)
+			printf("  -s %s:%s\n", signal->name, list->str);
+		g_string_free(list, TRUE);
+	}
+	if (computed)
+		printf("Signals defined by expressions follow the signals "
+		       "they name, channel numbers in them must be moved by "
+		       "hand\n");
+}
+
+gboolean plan_print(struct state *state)
+{
+	gint groups = state_noof_channel_groups_in_use(state);
+	gint capacity = state_buffer_capacity(state);
+	gint bytes = capacity * groups;
+	gboolean success = TRUE;
+	guint32 divider, flags;
+	glong rate = 0;
+
+	printf("Channel groups:  ");
+	for (gint g = 0, n = 0; g < NOOF_GROUPS; g++)
+		if (state->channels_in_use & (0xFFU << (8 * g)))
+			printf("%s%d", n++ > 0 ? ", " : "", g);
+	printf(" (%d of %d)\n", groups, NOOF_GROUPS);
+
+	printf("Sample rate:     ");
+	if (!device_clock(state, &divider, &flags)) {
+		printf("not possible\n");
+		success = FALSE;
+	} else if (state->external_clock) {
+		printf("external clock\n");
+	} else {
+		rate = device_sample_rate(divider, flags);
+		printf("%ld Hz", rate);
+		if (rate != state->sample_rate)
+			printf(" (%ld Hz requested)", state->sample_rate);
+		printf(", divider %u\n", divider);
+	}
+
+	printf("Buffer:          %d samples, %d before and %d from the "
+	       "trigger point\n", capacity, state->trigger_holdoff,
+	       capacity - state->trigger_holdoff);
+	if (rate > 0) {
+		printf("Capture window:  ");
+		print_seconds((gdouble)capacity / rate);
+		printf(", ");
+		print_seconds((gdouble)state->trigger_holdoff / rate);
+		printf(" before the trigger point\n");
+	}
+
+	/*
+	 * The device is a USB CDC device, the baud rate of the serial
+	 * port does not limit the transfer, so this is only nominal
+	 */
+	printf("Transfer:        %d bytes, nominally ", bytes);
+	print_seconds((gdouble)bytes * BITS_PER_BYTE
+		      / link_rate(state->baudrate));
+	printf(" at %ld baud\n", link_rate(state->baudrate));
+
+	printf("Trigger stages:  ");
+	if (!trigger_compile(state)) {
+		printf("the trigger cannot be set up\n");
+		success = FALSE;
+	} else if (state->trigger_spec == NULL) {
+		printf("none, the capture starts at once\n");
+	} else {
+		printf("%d of %d\n", state->noof_trigger_stages,
+		       NOOF_TRIGGERS);
+	}
+
+	print_packing(state, rate);
+	return success;
+}
@@ -0,0 +1,38 @@
+/* -*- linux-c -*-
+ *
+ * Predicting the cost of a capture before arming
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _PLAN_H_
+#define _PLAN_H_
+
+#include <glib.h>
+#include "state.h"
+
+/*
+ * Print the sample rate, depth, transfer size and trigger stages a
+ * capture with the state would get, and channel assignments using
+ * fewer channel groups, without touching the device. Return FALSE if
+ * the capture would fail.
+ */
+gboolean plan_print(struct state *state);
+
+#endif /* _PLAN_H_ */
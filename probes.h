@@ -0,0 +1,44 @@
+/* -*- linux-c -*-
+ *
+ * Static tracepoints
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+/*
+ * USDT probes for bpftrace, perf and SystemTap, provider "oblsc".
+ * They are built in when HAVE_SDT is defined and are then a single
+ * nop each until a tracer attaches. Without HAVE_SDT they vanish.
+ * Probe names use a double underscore where the tracers show a dash.
+ */
+#ifdef HAVE_SDT
+#include <sys/sdt.h>
+#define PROBE1(name, a) DTRACE_PROBE1(oblsc, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(oblsc, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(oblsc, name, a, b, c)
+#else
+#define PROBE1(name, a) do { } while (0)
+#define PROBE2(name, a, b) do { } while (0)
+#define PROBE3(name, a, b, c) do { } while (0)
+#endif
+
+#endif /* _PROBES_H_ */
@@ -0,0 +1,126 @@
+/* -*- linux-c -*-
+ *
+ * Time spent in the phases of a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <sys/resource.h>
+#include "profile.h"
+
+static const gchar *phase_names[PROFILE_NOOF_PHASES] = {
+	[PROFILE_OPEN] = "open",
+	[PROFILE_DRAIN] = "drain",
+	[PROFILE_IDENT] = "ident",
+	[PROFILE_CONFIGURE] = "configure",
+	[PROFILE_WAIT] = "wait",
+	[PROFILE_READBACK] = "readback",
+	[PROFILE_CONVERT] = "convert",
+	[PROFILE_OUTPUT] = "output"
+};
+
+static FILE *report;
+static gint noof_reports;
+static gint64 started[PROFILE_NOOF_PHASES]; /* us, monotonic */
+static gint64 elapsed[PROFILE_NOOF_PHASES]; /* us */
+static guint64 counters[PROFILE_NOOF_COUNTERS];
+/* Bytes received during the readback phase, for the link throughput */
+static guint64 readback_start;
+static guint64 readback_bytes;
+
+gboolean profile_open(const gchar *filename)
+{
+	report = fopen(filename, "a");
+	if (report == NULL) {
+		perror(filename);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void profile_begin(enum profile_phase phase)
+{
+	if (report == NULL)
+		return;
+	started[phase] = g_get_monotonic_time();
+	if (phase == PROFILE_READBACK)
+		readback_start = counters[PROFILE_RECEIVED];
+}
+
+void profile_end(enum profile_phase phase)
+{
+	if (report == NULL)
+		return;
+	elapsed[phase] += g_get_monotonic_time() - started[phase];
+	if (phase == PROFILE_READBACK)
+		readback_bytes += counters[PROFILE_RECEIVED] - readback_start;
+}
+
+void profile_count(enum profile_counter counter, gsize bytes)
+{
+	if (report == NULL)
+		return;
+	counters[counter] += bytes;
+}
+
+gboolean profile_report(struct state *state, struct capture *capture)
+{
+	struct rusage usage;
+	gint64 total = 0;
+
+	if (report == NULL)
+		return TRUE;
+
+	fprintf(report, "{\"capture\": %d, \"sample_rate\": %ld, "
+		"\"samples\": %d, \"seconds\": {",
+		noof_reports++, state->sample_rate, capture->noof_samples);
+	for (gint p = 0; p < PROFILE_NOOF_PHASES; p++) {
+		fprintf(report, "\"%s\": %.6f, ", phase_names[p],
+			elapsed[p] / 1e6);
+		total += elapsed[p];
+	}
+	fprintf(report, "\"total\": %.6f}, \"sent_bytes\": %" G_GUINT64_FORMAT
+		", \"received_bytes\": %" G_GUINT64_FORMAT
+		", \"readback_bytes_per_second\": ",
+		total / 1e6, counters[PROFILE_SENT],
+		counters[PROFILE_RECEIVED]);
+	if (elapsed[PROFILE_READBACK] > 0)
+		fprintf(report, "%.0f", readback_bytes * 1e6
+			/ elapsed[PROFILE_READBACK]);
+	else
+		fprintf(report, "null");
+	fprintf(report, ", \"output_bytes\": %" G_GUINT64_FORMAT,
+		counters[PROFILE_WRITTEN]);
+	/* Linux gives the peak resident set size in kilobytes */
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		fprintf(report, ", \"max_rss_kib\": %ld", usage.ru_maxrss);
+	fprintf(report, "}\n");
+
+	for (gint p = 0; p < PROFILE_NOOF_PHASES; p++)
+		elapsed[p] = 0;
+	for (gint c = 0; c < PROFILE_NOOF_COUNTERS; c++)
+		counters[c] = 0;
+	readback_bytes = 0;
+
+	if (fflush(report) == EOF) {
+		perror("Failed to write the phase report");
+		return FALSE;
+	}
+	return TRUE;
+}
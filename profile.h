@@ -0,0 +1,71 @@
+/* -*- linux-c -*-
+ *
+ * Time spent in the phases of a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+/* The phases are timed separately, in the order they happen */
+enum profile_phase {
+	PROFILE_OPEN, /* Opening the serial port */
+	PROFILE_DRAIN, /* Discarding stale input */
+	PROFILE_IDENT, /* Reset and identification */
+	PROFILE_CONFIGURE, /* Sample rate, flags, triggers and size */
+	PROFILE_WAIT, /* From the run command to the first sample */
+	PROFILE_READBACK, /* Reading the rest of the samples */
+	PROFILE_CONVERT, /* Building the capture from the raw samples */
+	PROFILE_OUTPUT, /* Writing the output, archive and decoded data */
+	PROFILE_NOOF_PHASES
+};
+
+enum profile_counter {
+	PROFILE_SENT, /* Bytes written to the device */
+	PROFILE_RECEIVED, /* Bytes read from the device */
+	PROFILE_WRITTEN, /* Bytes written to output files */
+	PROFILE_NOOF_COUNTERS
+};
+
+/*
+ * Append a JSON report per capture to filename. Until this is called
+ * all other functions do nothing. Return FALSE if the file cannot be
+ * opened.
+ */
+gboolean profile_open(const gchar *filename);
+
+void profile_begin(enum profile_phase phase);
+
+/* Add the time since profile_begin() to the phase */
+void profile_end(enum profile_phase phase);
+
+void profile_count(enum profile_counter counter, gsize bytes);
+
+/*
+ * Write the phases and counters accumulated since the previous report
+ * as a line of JSON and start over. Return FALSE on a write error.
+ */
+gboolean profile_report(struct state *state, struct capture *capture);
+
+#endif /* _PROFILE_H_ */
@@ -0,0 +1,167 @@
+/* -*- linux-c -*-
+ *
+ * Multi-resolution summary of a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pyramid.h"
+#include "output.h"
+
+static gint noof_levels(gint noof_samples)
+{
+	gint levels = 0;
+
+	for (gint entries = noof_samples; entries > 1;
+	     entries = (entries + 1) / 2)
+		levels++;
+	return levels;
+}
+
+static gint name_size(struct signal_def *signal)
+{
+	return (strlen(signal->name) + 7) & ~7;
+}
+
+/*
+ * Build all levels of one signal into entries, level after level.
+ * The first level is made from the samples and the transitions in the
+ * edge index, every following level merges pairs of the one below.
+ */
+static void build_levels(struct capture *capture, struct signal_def *signal,
+			 gint levels, struct pyramid_entry *entries)
+{
+	gint n = capture->noof_samples;
+	gint count = (n + 1) / 2;
+	struct pyramid_entry *below;
+
+	for (gint i = 0; i < count; i++) {
+		guint32 a = capture_signal_value(signal,
+						 capture->samples[2 * i]);
+		guint32 b = 2 * i + 1 < n ? capture_signal_value(
+			signal, capture->samples[2 * i + 1]) : a;
+
+		entries[i].min = MIN(a, b);
+		entries[i].max = MAX(a, b);
+		entries[i].transitions = 0;
+	}
+	for (gint c = 0; c < capture->noof_changes; c++)
+		if (capture->changes[c].diff & signal->mask)
+			entries[capture->changes[c].sample / 2].transitions++;
+
+	for (gint level = 1; level < levels; level++) {
+		gint below_count = count;
+
+		below = entries;
+		entries += below_count;
+		count = (below_count + 1) / 2;
+		for (gint i = 0; i < count; i++) {
+			struct pyramid_entry *a = &below[2 * i];
+			struct pyramid_entry *b = 2 * i + 1 < below_count
+				? &below[2 * i + 1] : NULL;
+
+			entries[i] = *a;
+			if (b == NULL)
+				continue;
+			entries[i].min = MIN(a->min, b->min);
+			entries[i].max = MAX(a->max, b->max);
+			entries[i].transitions += b->transitions;
+		}
+	}
+}
+
+gboolean pyramid_dump(struct state *state, struct capture *capture)
+{
+	struct pyramid_header header;
+	gint levels = noof_levels(capture->noof_samples);
+	gint noof_entries = 0;
+	guint64 offset;
+	struct pyramid_entry *entries;
+	struct output *out;
+	gchar *filename;
+	static const gchar padding[8];
+
+	if (state->outfile == NULL) {
+		fprintf(stderr,
+			"The summary pyramid is stored next to the output "
+			"file, which must be given\n");
+		return FALSE;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PYRAMID_MAGIC, sizeof(header.magic));
+	header.version = PYRAMID_VERSION;
+	header.noof_signals = state->noof_signals;
+	header.noof_samples = capture->noof_samples;
+	header.noof_levels = levels;
+	header.trigger = capture->trigger;
+	header.sample_rate = state->sample_rate;
+
+	for (gint count = capture->noof_samples, l = 0; l < levels; l++) {
+		count = (count + 1) / 2;
+		noof_entries += count;
+	}
+
+	offset = sizeof(header);
+	for (gint i = 0; i < state->noof_signals; i++)
+		offset += sizeof(struct pyramid_signal)
+			+ name_size(&state->signals[i])
+			+ levels * sizeof(struct pyramid_level);
+
+	filename = g_strdup_printf("%s.pyr", state->outfile);
+	out = output_open(filename, FALSE,
+			  offset + (gsize)state->noof_signals * noof_entries
+			  * sizeof(struct pyramid_entry));
+	g_free(filename);
+	if (out == NULL)
+		return FALSE;
+
+	output_write(out, &header, sizeof(header));
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+		struct pyramid_signal sig = {
+			.noof_bits = s->noof_bits,
+			.name_length = strlen(s->name)
+		};
+
+		output_write(out, &sig, sizeof(sig));
+		output_write(out, s->name, sig.name_length);
+		output_write(out, padding, name_size(s) - sig.name_length);
+		for (gint l = 0, count = capture->noof_samples; l < levels;
+		     l++) {
+			struct pyramid_level level;
+
+			count = (count + 1) / 2;
+			level.offset = offset;
+			level.noof_entries = count;
+			level.bucket_size_log2 = l + 1;
+			output_write(out, &level, sizeof(level));
+			offset += count * sizeof(struct pyramid_entry);
+		}
+	}
+
+	entries = g_malloc(MAX(noof_entries, 1) * sizeof(*entries));
+	for (gint i = 0; i < state->noof_signals; i++) {
+		build_levels(capture, &state->signals[i], levels, entries);
+		output_write(out, entries, noof_entries * sizeof(*entries));
+	}
+	g_free(entries);
+	return output_close(out);
+}
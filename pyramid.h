@@ -0,0 +1,80 @@
+/* -*- linux-c -*-
+ *
+ * Multi-resolution summary of a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _PYRAMID_H_
+#define _PYRAMID_H_
+
+#include "state.h"
+#include "capture.h"
+
+/*
+ * File layout, all fields in native byte order:
+ *
+ *   struct pyramid_header
+ *   For each signal:
+ *     struct pyramid_signal
+ *     The name, padded with zeros to a multiple of 8 bytes
+ *     struct pyramid_level[noof_levels]
+ *   The entries of all levels, at the offsets given by the levels
+ *
+ * Level n summarizes buckets of 2^(n + 1) samples. Every entry holds
+ * the minimum and maximum value of the signal within the bucket and
+ * the number of samples in the bucket at which the signal changes
+ * value. The last level has a single entry.
+ */
+
+#define PYRAMID_MAGIC "OBLSCPYR"
+#define PYRAMID_VERSION 1
+
+struct pyramid_header {
+	gchar magic[8];
+	guint32 version;
+	guint32 noof_signals;
+	guint32 noof_samples;
+	guint32 noof_levels;
+	gint32 trigger;
+	guint32 reserved;
+	gdouble sample_rate;
+};
+
+struct pyramid_signal {
+	guint32 noof_bits;
+	guint32 name_length;
+};
+
+struct pyramid_level {
+	guint64 offset; /* From the start of the file */
+	guint32 noof_entries;
+	guint32 bucket_size_log2;
+};
+
+struct pyramid_entry {
+	guint32 min;
+	guint32 max;
+	guint32 transitions;
+};
+
+/* Write the summary to <output filename>.pyr */
+gboolean pyramid_dump(struct state *state, struct capture *capture);
+
+#endif /* _PYRAMID_H_ */
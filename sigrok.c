@@ -0,0 +1,305 @@
+/* -*- linux-c -*-
+ *
+ * Sigrok session writer
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "sigrok.h"
+#include "output.h"
+
+/*
+ * A sigrok session file (format version 2) is a zip archive holding
+ * a 'version' file, an ini style 'metadata' file and the samples in
+ * files named 'logic-1-<n>'. Each sample is 'unitsize' bytes in
+ * little endian order where bit n holds probe n + 1.
+ */
+
+#define CHUNK_SIZE (4 * 1024 * 1024) /* bytes */
+
+struct zip_entry {
+	gchar *name;
+	guint32 crc;
+	guint32 size;
+	guint32 compressed_size;
+	guint32 offset;
+};
+
+struct zip {
+	GString *data;
+	GList *entries; /* struct zip_entry* */
+	guint16 dos_time;
+	guint16 dos_date;
+};
+
+static void put16(GString *s, guint16 v)
+{
+	g_string_append_c(s, v & 0xff);
+	g_string_append_c(s, v >> 8);
+}
+
+static void put32(GString *s, guint32 v)
+{
+	put16(s, v & 0xffff);
+	put16(s, v >> 16);
+}
+
+static gboolean zip_add(struct zip *zip, gchar *name,
+			const void *data, gsize size)
+{
+	struct zip_entry *e = g_malloc(sizeof(*e));
+	z_stream stream;
+	uLong bound;
+	guint8 *compressed;
+
+	memset(&stream, 0, sizeof(stream));
+	/* Negative window bits gives raw deflate data as used by zip */
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			 -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		g_free(name);
+		g_free(e);
+		return FALSE;
+	}
+	bound = deflateBound(&stream, size);
+	compressed = g_malloc(bound);
+	stream.next_in = (Bytef *)data;
+	stream.avail_in = size;
+	stream.next_out = compressed;
+	stream.avail_out = bound;
+	if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+		deflateEnd(&stream);
+		g_free(compressed);
+		g_free(name);
+		g_free(e);
+		return FALSE;
+	}
+
+	e->name = name;
+	e->crc = crc32(0, data, size);
+	e->size = size;
+	e->compressed_size = stream.total_out;
+	e->offset = zip->data->len;
+	deflateEnd(&stream);
+
+	put32(zip->data, 0x04034b50);
+	put16(zip->data, 20); /* Version needed, 2.0 */
+	put16(zip->data, 0); /* Flags */
+	put16(zip->data, 8); /* Deflate */
+	put16(zip->data, zip->dos_time);
+	put16(zip->data, zip->dos_date);
+	put32(zip->data, e->crc);
+	put32(zip->data, e->compressed_size);
+	put32(zip->data, e->size);
+	put16(zip->data, strlen(e->name));
+	put16(zip->data, 0); /* Extra field length */
+	g_string_append(zip->data, e->name);
+	g_string_append_len(zip->data, (gchar *)compressed,
+			    e->compressed_size);
+	g_free(compressed);
+
+	zip->entries = g_list_append(zip->entries, e);
+	return TRUE;
+}
+
+static void zip_finish(struct zip *zip)
+{
+	guint32 directory = zip->data->len, directory_size;
+	guint16 noof_entries = 0;
+
+	for (GList *i = zip->entries; i != NULL; i = g_list_next(i)) {
+		struct zip_entry *e = i->data;
+
+		put32(zip->data, 0x02014b50);
+		put16(zip->data, 20); /* Version made by */
+		put16(zip->data, 20); /* Version needed */
+		put16(zip->data, 0);
+		put16(zip->data, 8);
+		put16(zip->data, zip->dos_time);
+		put16(zip->data, zip->dos_date);
+		put32(zip->data, e->crc);
+		put32(zip->data, e->compressed_size);
+		put32(zip->data, e->size);
+		put16(zip->data, strlen(e->name));
+		put16(zip->data, 0); /* Extra field length */
+		put16(zip->data, 0); /* Comment length */
+		put16(zip->data, 0); /* Disk number */
+		put16(zip->data, 0); /* Internal attributes */
+		put32(zip->data, 0); /* External attributes */
+		put32(zip->data, e->offset);
+		g_string_append(zip->data, e->name);
+		noof_entries++;
+	}
+	directory_size = zip->data->len - directory;
+
+	put32(zip->data, 0x06054b50);
+	put16(zip->data, 0); /* This disk */
+	put16(zip->data, 0); /* Disk with the directory */
+	put16(zip->data, noof_entries);
+	put16(zip->data, noof_entries);
+	put32(zip->data, directory_size);
+	put32(zip->data, directory);
+	put16(zip->data, 0); /* Comment length */
+}
+
+static void zip_free(struct zip *zip)
+{
+	for (GList *i = zip->entries; i != NULL; i = g_list_next(i)) {
+		struct zip_entry *e = i->data;
+
+		g_free(e->name);
+		g_free(e);
+	}
+	g_list_free(zip->entries);
+	g_string_free(zip->data, TRUE);
+}
+
+static gchar *samplerate_string(glong rate)
+{
+	if (rate % 1000000 == 0)
+		return g_strdup_printf("%ld MHz", rate / 1000000);
+	if (rate % 1000 == 0)
+		return g_strdup_printf("%ld kHz", rate / 1000);
+	return g_strdup_printf("%ld Hz", rate);
+}
+
+static GString *make_metadata(struct state *state, gint noof_probes,
+			      gint unitsize)
+{
+	GString *m = g_string_new(NULL);
+	gchar *rate = samplerate_string(state->sample_rate);
+	gint probe = 1;
+
+	g_string_append_printf(m, "[global]\n");
+	g_string_append_printf(m, "sigrok version=0.5.0\n\n");
+	g_string_append_printf(m, "[device 1]\n");
+	g_string_append_printf(m, "capturefile=logic-1\n");
+	g_string_append_printf(m, "total probes=%d\n", noof_probes);
+	g_string_append_printf(m, "samplerate=%s\n", rate);
+	g_string_append_printf(m, "total analog=0\n");
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+
+		if (s->noof_bits == 1) {
+			g_string_append_printf(m, "probe%d=%s\n",
+					       probe++, s->name);
+			continue;
+		}
+		for (gint bit = 0; bit < s->noof_bits; bit++)
+			g_string_append_printf(m, "probe%d=%s[%d]\n",
+					       probe++, s->name, bit);
+	}
+	g_string_append_printf(m, "unitsize=%d\n", unitsize);
+	g_free(rate);
+	return m;
+}
+
+/*
+ * Repack the samples so that the channels of each signal are laid
+ * out next to each other, in signal order, as the probes are
+ * numbered.
+ */
+static guint8 *pack_samples(struct state *state, struct capture *capture,
+			    gint noof_probes, gint unitsize)
+{
+	guint8 *packed = g_malloc0((gsize)capture->noof_samples * unitsize);
+	gint channels[noof_probes];
+	gint probe = 0;
+
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *s = &state->signals[i];
+
+		for (gint bit = 0; bit < s->noof_bits; bit++)
+			channels[probe++] = s->channels[bit];
+	}
+
+	for (gint n = 0; n < capture->noof_samples; n++) {
+		sample_t sample = capture->samples[n];
+		guint8 *p = packed + (gsize)n * unitsize;
+
+		for (probe = 0; probe < noof_probes; probe++)
+			p[probe / 8] |= ((sample >> channels[probe]) & 1)
+				<< (probe % 8);
+	}
+	return packed;
+}
+
+gboolean sigrok_dump(struct state *state, struct capture *capture)
+{
+	struct zip zip = {
+		.data = g_string_new(NULL),
+		.entries = NULL
+	};
+	struct output *out;
+	GString *metadata;
+	guint8 *packed;
+	gint noof_probes = 0;
+	gint unitsize;
+	gsize size, chunk_samples;
+	time_t t = time(NULL);
+	struct tm *tm = localtime(&t);
+	gboolean success = FALSE;
+
+	for (gint i = 0; i < state->noof_signals; i++)
+		noof_probes += state->signals[i].noof_bits;
+	unitsize = (noof_probes + 7) / 8;
+
+	zip.dos_time = (tm->tm_hour << 11) | (tm->tm_min << 5)
+		| (tm->tm_sec / 2);
+	zip.dos_date = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5)
+		| tm->tm_mday;
+
+	if (!zip_add(&zip, g_strdup("version"), "2", 1))
+		goto error;
+	metadata = make_metadata(state, noof_probes, unitsize);
+	if (!zip_add(&zip, g_strdup("metadata"), metadata->str,
+		     metadata->len)) {
+		g_string_free(metadata, TRUE);
+		goto error;
+	}
+	g_string_free(metadata, TRUE);
+
+	packed = pack_samples(state, capture, noof_probes, unitsize);
+	size = (gsize)capture->noof_samples * unitsize;
+	chunk_samples = CHUNK_SIZE / unitsize;
+	for (gsize offset = 0, n = 1; offset < size; n++) {
+		gsize len = MIN(size - offset, chunk_samples * unitsize);
+
+		if (!zip_add(&zip, g_strdup_printf("logic-1-%d", (gint)n),
+			     packed + offset, len)) {
+			g_free(packed);
+			goto error;
+		}
+		offset += len;
+	}
+	g_free(packed);
+	zip_finish(&zip);
+
+	if ((out = output_open(state->outfile, FALSE, zip.data->len)) == NULL)
+		goto error;
+	output_write(out, zip.data->str, zip.data->len);
+	success = output_close(out);
+error:
+	if (!success)
+		fprintf(stderr, "Failed to write sigrok session\n");
+	zip_free(&zip);
+	return success;
+}
@@ -0,0 +1,171 @@
+/* -*- linux-c -*-
+ *
+ * Software trigger evaluated over a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include "soft_trigger.h"
+#include "trigger.h"
+#include "trigger_type.h"
+
+struct soft_trigger {
+	struct trigger_state trigger_state;
+	glong sample_rate; /* The times of the trigger were converted at */
+};
+
+struct soft_trigger *soft_trigger_compile(struct state *state)
+{
+	struct soft_trigger *r = g_malloc0(sizeof(*r));
+
+	if (!trigger_compile_software(state, state->soft_trigger_spec,
+				      &r->trigger_state)) {
+		soft_trigger_free(r);
+		return NULL;
+	}
+	r->sample_rate = state->sample_rate;
+	return r;
+}
+
+void soft_trigger_free(struct soft_trigger *trigger)
+{
+	trigger_state_release(&trigger->trigger_state);
+	g_free(trigger);
+}
+
+/*
+ * Set match[e] if the steps of trigger all hold for the samples
+ * ending at sample e. Each step is checked with a flat compare over
+ * the samples followed by a prefix count, so that whether a step
+ * holds for a run of samples is a single subtraction. Return the
+ * number of samples covered by the steps.
+ */
+static gint match_trigger(struct trigger *trigger, struct capture *capture,
+			  guint8 *match, gint *count)
+{
+	gint n = capture->noof_samples;
+	sample_t *samples = capture->samples;
+	gint length = 0;
+	gint offset = 0;
+
+	for (gint s = 0; s < trigger->noof_steps; s++)
+		length += trigger->steps[s].length;
+
+	for (gint e = 0; e < n; e++)
+		match[e] = e >= length - 1;
+
+	/* Walk the steps from the most recent one */
+	for (gint s = trigger->noof_steps - 1; s >= 0; s--) {
+		struct trigger_step *step = &trigger->steps[s];
+		sample_t value = step->pattern.value;
+		sample_t mask = step->pattern.mask;
+		gint l = step->length;
+
+		count[0] = 0;
+		for (gint i = 0; i < n; i++)
+			count[i + 1] = count[i]
+				+ (((samples[i] ^ value) & mask) == 0);
+
+		/* The step covers [e + 1 - offset - l, e + 1 - offset) */
+		for (gint e = MAX(length - 1, 0); e < n; e++)
+			match[e] &= count[e + 1 - offset]
+				- count[e + 1 - offset - l] == l;
+		offset += l;
+	}
+	return length;
+}
+
+/* Return the first sample at or after from where match is set, or -1 */
+static gint first_match(guint8 *match, gint n, gint from)
+{
+	for (gint e = MAX(from, 0); e < n; e++)
+		if (match[e])
+			return e;
+	return -1;
+}
+
+gint soft_trigger_find(struct soft_trigger *trigger, struct capture *capture)
+{
+	struct trigger_state *ts = &trigger->trigger_state;
+	gint n = capture->noof_samples;
+	guint8 *match = g_malloc(n);
+	gint *count = g_malloc((n + 1) * sizeof(*count));
+	gint fire = -1;
+	gint from = 0;
+
+	/* --auto-rate has chosen another rate since it was compiled */
+	if (trigger->sample_rate != ts->state->sample_rate) {
+		trigger_state_release(ts);
+		if (!trigger_compile_software(ts->state,
+					      ts->state->soft_trigger_spec,
+					      ts)) {
+			fprintf(stderr, "Failed to set up software trigger\n");
+			goto error;
+		}
+		trigger->sample_rate = ts->state->sample_rate;
+	}
+
+	for (GList *i = ts->triggers; i != NULL; i = g_list_next(i)) {
+		struct trigger *t = i->data;
+		gint length = match_trigger(t, capture, match, count);
+		/* All of the steps must hold after the stage is armed */
+		gint e = first_match(match, n, from + MAX(length - 1, 0));
+
+		if (e != -1 && e + t->delay >= n)
+			e = -1;
+
+		if (ts->sequential) {
+			/* The next stage is armed once this one fires */
+			if (e == -1) {
+				fire = -1;
+				break;
+			}
+			fire = e + t->delay;
+			from = fire + 1;
+		} else if (e != -1 && (fire == -1 || e + t->delay < fire)) {
+			/* The first of the parallel triggers to fire */
+			fire = e + t->delay;
+		}
+	}
+
+error:
+	g_free(count);
+	g_free(match);
+	return fire;
+}
+
+gboolean soft_trigger_apply(struct soft_trigger *trigger,
+			    struct capture *capture)
+{
+	struct state *state = trigger->trigger_state.state;
+	gint fire = soft_trigger_find(trigger, capture);
+
+	if (fire == -1) {
+		fprintf(stderr, "The software trigger did not fire\n");
+		return FALSE;
+	}
+
+	/* The trigger sample is kept even for an empty after window */
+	capture->trigger = fire;
+	capture_crop(capture,
+		     fire - MIN(state->soft_before, fire),
+		     fire + MAX(1, MIN(state->soft_after,
+				       capture->noof_samples - fire)));
+	return TRUE;
+}
@@ -0,0 +1,53 @@
+/* -*- linux-c -*-
+ *
+ * Software trigger evaluated over a capture
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _SOFT_TRIGGER_H_
+#define _SOFT_TRIGGER_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+struct soft_trigger;
+
+/*
+ * Parse the software trigger of state. It uses the same syntax as
+ * the hardware trigger but has no limit on the number of stages, the
+ * length of pattern sequences or the delays. Return NULL on error.
+ */
+struct soft_trigger *soft_trigger_compile(struct state *state);
+
+void soft_trigger_free(struct soft_trigger *trigger);
+
+/* Return the sample at which the trigger fires, -1 if it does not */
+gint soft_trigger_find(struct soft_trigger *trigger, struct capture *capture);
+
+/*
+ * Move the trigger point of the capture to where the software
+ * trigger fires and crop it to the window given in the state. Return
+ * FALSE if the trigger does not fire.
+ */
+gboolean soft_trigger_apply(struct soft_trigger *trigger,
+			    struct capture *capture);
+
+#endif /* _SOFT_TRIGGER_H_ */
@@ -24,28 +24,91 @@
 #include <stdlib.h>
 #include "state.h"
 
-void state_add_signal(struct state *state, gchar *name, GList *channels)
+void state_add_signal(struct state *state, gchar *name,
+		      const gint *channels, gint noof_bits)
 {
-	struct signal_def *d = g_malloc(sizeof(*d));
+	struct signal_def *d;
 
+	if (noof_bits > MAX_SIGNAL_BITS) {
+		fprintf(stderr, "Signal %s is wider than %d bits\n",
+			name, MAX_SIGNAL_BITS);
+		exit(1);
+	}
+	if (state->signal_names == NULL)
+		state->signal_names = g_hash_table_new(g_str_hash,
+						       g_str_equal);
+	if (g_hash_table_lookup(state->signal_names, name) != NULL) {
+		fprintf(stderr, "Signal %s is defined more than once\n",
+			name);
+		exit(1);
+	}
+
+	state->signals = g_renew(struct signal_def, state->signals,
+				 state->noof_signals + 1);
+	d = &state->signals[state->noof_signals];
 	d->name = g_strdup(name);
-	d->channels = channels;
 	d->index = state->noof_signals++;
-	d->noof_bits = g_list_length(channels);
+	d->noof_bits = noof_bits;
 	d->mask = 0;
+	for (gint bit = 0; bit < noof_bits; bit++) {
+		gint channel = channels[bit];
 
-	for (GList *i = d->channels; i != NULL; i = g_list_next(i)) {
-		int channel = GPOINTER_TO_INT(i->data);
-
-		if (channel < 0 || channel > 31) {
+		if (channel < 0 || channel >= NOOF_PHYSICAL_CHANNELS
+		    + state->noof_virtual_channels) {
 			fprintf(stderr, "Unsupported channel number %d\n",
 				channel);
 			exit(1);
 		}
-		d->mask |= (1 << channel);
-		state->channels_in_use |= (1 << channel);
+		d->channels[bit] = channel;
+		d->mask |= ((guint64)1 << channel);
+		if (channel < NOOF_PHYSICAL_CHANNELS)
+			state->channels_in_use |= (1 << channel);
 	}
-	state->signals = g_list_append(state->signals, d);
+	g_hash_table_insert(state->signal_names, d->name,
+			    GINT_TO_POINTER(d->index + 1));
+}
+
+gint state_add_virtual_channel(struct state *state, enum virtual_op op,
+			       gint a, gint b)
+{
+	struct virtual_channel *v;
+
+	if (op == VIRTUAL_NOT)
+		b = -1;
+	/* All operations but not are commutative */
+	if (op != VIRTUAL_NOT && a > b) {
+		gint tmp = a;
+
+		a = b;
+		b = tmp;
+	}
+	for (gint i = 0; i < state->noof_virtual_channels; i++) {
+		v = &state->virtual_channels[i];
+		if (v->op == op && v->a == a && v->b == b)
+			return NOOF_PHYSICAL_CHANNELS + i;
+	}
+
+	if (state->noof_virtual_channels == MAX_VIRTUAL_CHANNELS) {
+		fprintf(stderr, "Virtual channels exhausted, at most %d "
+			"can be used\n", MAX_VIRTUAL_CHANNELS);
+		exit(1);
+	}
+	for (gint c = 0; c < 2; c++) {
+		gint channel = c == 0 ? a : b;
+
+		if (channel >= 0 && channel < NOOF_PHYSICAL_CHANNELS)
+			state->channels_in_use |= (1 << channel);
+	}
+	v = &state->virtual_channels[state->noof_virtual_channels];
+	v->op = op;
+	v->a = a;
+	v->b = b;
+	return NOOF_PHYSICAL_CHANNELS + state->noof_virtual_channels++;
+}
+
+gboolean state_signal_is_virtual(struct signal_def *signal)
+{
+	return (signal->mask >> NOOF_PHYSICAL_CHANNELS) != 0;
 }
 
 gint state_noof_channel_groups_in_use(struct state *state)
@@ -72,32 +135,26 @@ gint state_buffer_capacity(struct state *state)
 /* Return NULL if no such signal is defined */
 struct signal_def *state_lookup_signal(struct state *state, gchar *name)
 {
-	for (GList *i = state->signals; i != NULL; i = g_list_next(i)) {
-		struct signal_def *s = (struct signal_def *)i->data;
+	gint index;
 
-		if (g_strcmp0(s->name, name) == 0)
-			return s;
-	}
-	return NULL;
+	if (state->signal_names == NULL)
+		return NULL;
+	index = GPOINTER_TO_INT(g_hash_table_lookup(state->signal_names,
+						    name));
+	return index ? &state->signals[index - 1] : NULL;
 }
 
-guint32 state_signal_value(struct signal_def *signal, guint32 value)
+guint64 state_signal_value(struct signal_def *signal, guint32 value)
 {
-	gint index = 0;
-	guint32 r = 0;
+	guint64 r = 0;
 
-	for (GList *i = signal->channels;
-	     i != NULL;
-	     i = g_list_next(i), index++) {
-		int channel = GPOINTER_TO_INT(i->data);
-
-		if (value & (1 << index))
-			r |= (1 << channel);
-	}
+	for (gint bit = 0; bit < signal->noof_bits; bit++)
+		if (value & (1 << bit))
+			r |= ((guint64)1 << signal->channels[bit]);
 	return r;
 }
 
-guint32 state_signal_mask(struct signal_def *signal)
+guint64 state_signal_mask(struct signal_def *signal)
 {
 	return signal->mask;
 }
@@ -28,40 +28,117 @@
 #include <termios.h>
 #include <unistd.h>
 #include "sump.h"
+#include "output.h"
 
 #define MEMORY_SIZE (24*1024) /* bytes */
 #define CLOCK_FREQ  100000000 /* Hz */
 #define NOOF_TRIGGERS 4
 #define MAX_SAMPLE_DELAY 0xFFFF
+#define NOOF_PHYSICAL_CHANNELS 32
+#define MAX_VIRTUAL_CHANNELS 32
+#define MAX_SIGNAL_BITS 32
+
+enum output_format {
+	FORMAT_VCD,
+	FORMAT_FST,
+	FORMAT_SIGROK,
+	FORMAT_NPY,
+	FORMAT_CAPTURE
+};
 
 struct signal_def {
 	gint index;
 	gchar *name;
 	gint noof_bits;
-	guint32 mask;
-	GList *channels; /* gints */
+	guint64 mask;
+	gint channels[MAX_SIGNAL_BITS]; /* By bit, least significant first */
+};
+
+enum virtual_op {
+	VIRTUAL_NOT,
+	VIRTUAL_AND,
+	VIRTUAL_OR,
+	VIRTUAL_XOR
+};
+
+/*
+ * A channel computed from one or two other channels. Virtual channel
+ * n is channel number NOOF_PHYSICAL_CHANNELS + n and only depends on
+ * channels with lower numbers.
+ */
+struct virtual_channel {
+	enum virtual_op op;
+	gint a;
+	gint b; /* Not used by VIRTUAL_NOT */
 };
 
 struct state {
 	/* Command line parameters */
 	gchar *device;
 	gchar *outfile;
+	enum output_format format;
+	gboolean compress;
+	gboolean pyramid;
+	gboolean stats;
+	gchar **decoders;
+	gchar *decode_outfile;
+	enum output_policy write_policy;
 	speed_t baudrate;
 	glong sample_rate;
+	gboolean auto_rate;
 	gboolean external_clock;
 	gboolean external_invert;
 	gboolean filter;
 	gchar *trigger_spec;
 	gint trigger_holdoff;
+	gchar *soft_trigger_spec;
+	/* Samples kept before and after the software trigger point */
+	gint soft_before;
+	gint soft_after;
+	gchar **input_files;
+	gchar *compare_file;
+	gchar **compare_masks;
+	gint compare_tolerance;
+	gchar *archive_dir;
+	gchar **queries;
+	gboolean jitter;
+	gint repeat;
+	gint jitter_edges;
+	gboolean live;
+	gboolean simulate_trigger;
+	gboolean plan;
+	gchar *stats_json; /* Per capture phase report, see profile.h */
+	/* Minimum pulse width per channel, see deglitch.h */
+	gint deglitch_width[NOOF_PHYSICAL_CHANNELS + MAX_VIRTUAL_CHANNELS];
 
-	guint32 channels_in_use; /* Bit-vector of used channels */
+	guint32 channels_in_use; /* Bit-vector of used physical channels */
+	/*
+	 * The signals in the order they were defined, signals[i] has
+	 * index i. Adding a signal may move the array, so pointers to
+	 * signals are only kept once all of them are defined.
+	 */
 	gint noof_signals;
-	GList *signals; /* struct signal_def* */
+	struct signal_def *signals;
+	GHashTable *signal_names; /* Name to index + 1 */
+	gint noof_virtual_channels;
+	struct virtual_channel virtual_channels[MAX_VIRTUAL_CHANNELS];
 	struct sump_trigger triggers[NOOF_TRIGGERS];
+	gint noof_trigger_stages; /* In use, set by trigger_compile() */
 };
 
-/* channels is a list of gints */
-void state_add_signal(struct state *state, gchar *name, GList *channels);
+/* channels[bit] is the channel of each of the noof_bits bits */
+void state_add_signal(struct state *state, gchar *name,
+		      const gint *channels, gint noof_bits);
+
+/*
+ * Return the channel number of a virtual channel computing op on
+ * channels a and b, an existing channel is reused if there is one.
+ */
+gint state_add_virtual_channel(struct state *state, enum virtual_op op,
+			       gint a, gint b);
+
+/* Return TRUE if any of the channels of the signal is virtual */
+gboolean state_signal_is_virtual(struct signal_def *signal);
 
 gint state_noof_channel_groups_in_use(struct state *state);
 
@@ -71,9 +148,9 @@ gint state_buffer_capacity(struct state *state);
 /* Return NULL if no such signal is defined */
 struct signal_def *state_lookup_signal(struct state *state, gchar *name);
 
-guint32 state_signal_value(struct signal_def *signal,
+guint64 state_signal_value(struct signal_def *signal,
 			   guint32 value);
 
-guint32 state_signal_mask(struct signal_def *signal);
+guint64 state_signal_mask(struct signal_def *signal);
 
 #endif /* _STATE_H_ */
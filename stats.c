@@ -0,0 +1,177 @@
+/* -*- linux-c -*-
+ *
+ * Signal statistics
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+#include "output.h"
+
+/* Pulse widths are counted in buckets of [2^n, 2^(n + 1)) samples */
+#define NOOF_BUCKETS 32
+
+struct channel_stats {
+	gint high; /* Number of samples at which the channel is 1 */
+	gint rising;
+	gint falling;
+	gint first_rising;
+	gint last_rising;
+	gint glitches;
+	gint high_widths[NOOF_BUCKETS];
+	gint low_widths[NOOF_BUCKETS];
+};
+
+static gint count_high(struct capture *capture, gint channel)
+{
+	guint64 *plane = capture_bitplane(capture, channel);
+	gint words = (capture->noof_samples + 63) / 64;
+	gint r = 0;
+
+	for (gint w = 0; w < words; w++)
+		r += __builtin_popcountll(plane[w]);
+	g_free(plane);
+	return r;
+}
+
+static void channel_stats(struct capture *capture, gint channel,
+			  struct channel_stats *cs)
+{
+	gint *edges = capture->edges[channel];
+	gint noof_edges = capture->noof_edges[channel];
+
+	memset(cs, 0, sizeof(*cs));
+	cs->high = count_high(capture, channel);
+	cs->first_rising = -1;
+
+	for (gint e = 0; e < noof_edges; e++) {
+		gboolean high = (capture->samples[edges[e]] >> channel) & 1;
+
+		if (high) {
+			if (cs->first_rising == -1)
+				cs->first_rising = edges[e];
+			cs->last_rising = edges[e];
+			cs->rising++;
+		} else
+			cs->falling++;
+
+		/* Only pulses with both edges in the capture are counted */
+		if (e + 1 < noof_edges) {
+			gint width = edges[e + 1] - edges[e];
+			gint bucket = 31 - __builtin_clz(width);
+
+			if (high)
+				cs->high_widths[bucket]++;
+			else
+				cs->low_widths[bucket]++;
+			if (width == 1)
+				cs->glitches++;
+		}
+	}
+}
+
+void stats_write_string(struct output *out, const gchar *s)
+{
+	output_putc(out, '"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			output_printf(out, "\\%c", *s);
+		else if ((guchar)*s < 0x20)
+			output_printf(out, "\\u%04x", *s);
+		else
+			output_putc(out, *s);
+	}
+	output_putc(out, '"');
+}
+
+static void write_histogram(struct output *out, const gchar *name,
+			    gint *buckets)
+{
+	gint used = NOOF_BUCKETS;
+
+	while (used > 0 && buckets[used - 1] == 0)
+		used--;
+	output_printf(out, ", \"%s\": [", name);
+	for (gint b = 0; b < used; b++)
+		output_printf(out, "%s%d", b ? ", " : "", buckets[b]);
+	output_putc(out, ']');
+}
+
+static void write_signal(struct output *out, struct state *state,
+			 struct capture *capture, struct signal_def *signal)
+{
+	gint changes = 0;
+	struct channel_stats cs;
+	gint channel;
+
+	for (gint c = 0; c < capture->noof_changes; c++)
+		if (capture->changes[c].diff & signal->mask)
+			changes++;
+
+	stats_write_string(out, signal->name);
+	output_printf(out, ": {\"bits\": %d, \"changes\": %d",
+		      signal->noof_bits, changes);
+	if (signal->noof_bits != 1) {
+		output_putc(out, '}');
+		return;
+	}
+
+	channel = signal->channels[0];
+	channel_stats(capture, channel, &cs);
+	output_printf(out, ", \"rising\": %d, \"falling\": %d, "
+		      "\"duty\": %.6g, \"glitches\": %d",
+		      cs.rising, cs.falling,
+		      capture->noof_samples
+		      ? (gdouble)cs.high / capture->noof_samples : 0.0,
+		      cs.glitches);
+	if (cs.rising >= 2) {
+		gdouble period = (gdouble)(cs.last_rising - cs.first_rising)
+			/ (cs.rising - 1);
+
+		output_printf(out, ", \"period\": %.9g, \"frequency\": %.9g",
+			      period / state->sample_rate,
+			      state->sample_rate / period);
+	} else
+		output_printf(out, ", \"period\": null, \"frequency\": null");
+	write_histogram(out, "high_widths", cs.high_widths);
+	write_histogram(out, "low_widths", cs.low_widths);
+	output_putc(out, '}');
+}
+
+gboolean stats_dump(struct state *state, struct capture *capture)
+{
+	struct output *out = output_open(state->outfile, state->compress, 0);
+
+	if (out == NULL)
+		return FALSE;
+
+	output_printf(out, "{\"sample_rate\": %ld, \"samples\": %d, "
+		      "\"trigger\": %d, \"signals\": {",
+		      state->sample_rate, capture->noof_samples,
+		      capture->trigger);
+	for (gint i = 0; i < state->noof_signals; i++) {
+		output_printf(out, "\n  ");
+		write_signal(out, state, capture, &state->signals[i]);
+		if (i + 1 < state->noof_signals)
+			output_putc(out, ',');
+	}
+	output_printf(out, "\n}}\n");
+	return output_close(out);
+}
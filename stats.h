@@ -0,0 +1,40 @@
+/* -*- linux-c -*-
+ *
+ * Signal statistics
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "state.h"
+#include "capture.h"
+#include "output.h"
+
+/*
+ * Write per-signal statistics as JSON to the output file instead of
+ * the samples.
+ */
+gboolean stats_dump(struct state *state, struct capture *capture);
+
+/* Write s as a quoted JSON string */
+void stats_write_string(struct output *out, const gchar *s);
+
+#endif /* _STATS_H_ */
@@ -30,6 +30,8 @@
 #include <sys/select.h>
 #include "sump.h"
 #include "serial.h"
+#include "profile.h"
+#include "probes.h"
 
 #define WRITE_TIMEOUT_MS 1000
 #define CMD_TIMEOUT_MS    200
@@ -88,6 +90,7 @@ gboolean sump_drain_input(gint fd)
 				perror("read");
 				return FALSE;
 			}
+			profile_count(PROFILE_RECEIVED, r);
 		} else if (sel_result == 0)
 			return TRUE;
 		else {
@@ -118,7 +121,7 @@ void sump_dump_buffer(gsize size, gpointer buffer)
 	fprintf(stderr, "\n");
 }
 
-static gboolean send_buffer(gint fd, gsize size, gpointer buffer)
+static gboolean write_buffer(gint fd, gsize size, gpointer buffer)
 {
 	ssize_t r;
 	guint8 *b = buffer;
@@ -148,6 +151,7 @@ static gboolean send_buffer(gint fd, gsize size, gpointer buffer)
 				perror("write in sump_send_buffer");
 				return FALSE;
 			}
+			profile_count(PROFILE_SENT, r);
 			size -= r;
 			b += r;
 		}
@@ -155,9 +159,19 @@ static gboolean send_buffer(gint fd, gsize size, gpointer buffer)
 	return TRUE;
 }
 
+static gboolean send_buffer(gint fd, gsize size, gpointer buffer)
+{
+	gboolean ok;
+
+	PROBE2(send__start, *(guint8 *)buffer, size);
+	ok = write_buffer(fd, size, buffer);
+	PROBE2(send__done, *(guint8 *)buffer, ok);
+	return ok;
+}
 
 
-gboolean sump_read_buffer(gint fd, gsize size, gpointer buffer, gint timeout)
+
+static gboolean read_buffer(gint fd, gsize size, gpointer buffer, gint timeout)
 {
 	guint8 *b = buffer;
 	ssize_t r;
@@ -186,6 +200,7 @@ gboolean sump_read_buffer(gint fd, gsize size, gpointer buffer, gint timeout)
 			} else if (r == 0) {
 				return FALSE;
 			}
+			profile_count(PROFILE_RECEIVED, r);
 			size -= r;
 			b += r;
 		} else if (sel_result == 0)
@@ -198,6 +213,16 @@ gboolean sump_read_buffer(gint fd, gsize size, gpointer buffer, gint timeout)
 	return TRUE;
 }
 
+gboolean sump_read_buffer(gint fd, gsize size, gpointer buffer, gint timeout)
+{
+	gboolean ok;
+
+	PROBE2(receive__start, size, timeout);
+	ok = read_buffer(fd, size, buffer, timeout);
+	PROBE2(receive__done, size, ok);
+	return ok;
+}
+
 gboolean sump_cmd_reset(gint fd)
 {
 	guint8 buff[5] = {
@@ -218,34 +243,35 @@ gboolean sump_cmd_id(gint fd, guint32 *ident)
 	return sump_read_buffer(fd, sizeof(*ident), ident, CMD_TIMEOUT_MS);
 }
 
+/* A long command, the argument is sent least significant byte first */
+static void put_command(guint8 *buffer, guint8 command, guint32 argument)
+{
+	buffer[0] = command;
+	for (gint i = 0; i < 4; i++)
+		buffer[i + 1] = (argument >> (8 * i)) & 0xFF;
+}
+
+guint32 sump_trigger_config(struct sump_trigger *trigger)
+{
+	return trigger->delay
+		| ((guint32)trigger->level << SUMP_TRIGGER_LEVEL_SHIFT)
+		| ((guint32)trigger->channel << SUMP_TRIGGER_CHANNEL_SHIFT)
+		| (trigger->serial ? SUMP_TRIGGER_SERIAL : 0)
+		| (trigger->start ? SUMP_TRIGGER_START : 0);
+}
+
 gboolean sump_cmd_set_trigger(gint fd, struct sump_trigger *trigger)
 {
-	guint8 buffer[] = {
-		CMD_SET_TRIGGER_0_MASK,
-		0, 0, 0, 0,
-		CMD_SET_TRIGGER_0_VALUES,
-		0, 0, 0, 0,
-		CMD_SET_TRIGGER_0_CONF,
-		0, 0, 0, 0,
-		0
-	};
-	guint32 *mask_ptr = (guint32 *)(buffer + 1);
-	guint32 *values_ptr = (guint32 *)(buffer + 6);
-	guint32 *delay_ptr = (guint32 *)(buffer + 11);
-	guint32 *conf_ptr = (guint32 *)(buffer + 13);
+	guint8 buffer[15];
+	guint8 offset = trigger->trigger * 4;
 
 	if (trigger->trigger > 3 || trigger->level > 3 || trigger->channel > 31)
 		return FALSE;
-	for (gint i = 0; i < 3; i++)
-		buffer[i * 5] += trigger->trigger * 4;
-	*mask_ptr = trigger->mask;
-	*values_ptr = trigger->values;
-	*delay_ptr = trigger->level;
-	*conf_ptr = (trigger->start ? 0x800 : 0)
-		| (trigger->serial ? 4 : 0)
-		| (trigger->level << 8)
-		| ((trigger->channel & 0xf) << 12)
-		| ((trigger->channel & 0x10) >> 4);
+	put_command(buffer, CMD_SET_TRIGGER_0_MASK + offset, trigger->mask);
+	put_command(buffer + 5, CMD_SET_TRIGGER_0_VALUES + offset,
+		    trigger->values);
+	put_command(buffer + 10, CMD_SET_TRIGGER_0_CONF + offset,
+		    sump_trigger_config(trigger));
 	return send_buffer(fd, sizeof(buffer), buffer);
 }
 
@@ -264,27 +290,18 @@ gboolean sump_cmd_set_divider(gint fd, guint32 divider)
 gboolean sump_cmd_set_size(gint fd,
 			   guint16 read_count, guint16 delay_count)
 {
-	guint8 buffer[] = {
-		CMD_SET_READ_AND_DELAY_COUNT,
-		0, 0, 0, 0, 0
-	};
-	guint32 *read_ptr = (guint32 *)(buffer + 1);
-	guint32 *delay_ptr = (guint32 *)(buffer + 3);
+	guint8 buffer[5];
 
-	*read_ptr = read_count;
-	*delay_ptr = delay_count;
+	put_command(buffer, CMD_SET_READ_AND_DELAY_COUNT,
+		    read_count | ((guint32)delay_count << 16));
 	return send_buffer(fd, sizeof(buffer), buffer);
 }
 
 gboolean sump_cmd_set_flags(gint fd, guint32 flags)
 {
-	guint8 buffer[] = {
-		CMD_SET_FLAGS,
-		0, 0, 0, 0
-	};
-	guint32 *ptr = (guint32 *)(buffer + 1);
+	guint8 buffer[5];
 
-	*ptr = flags;
+	put_command(buffer, CMD_SET_FLAGS, flags);
 	return send_buffer(fd, sizeof(buffer), buffer);
 }
 
@@ -45,6 +45,9 @@ gboolean sump_read_buffer(gint fd, gsize size, gpointer buffer, gint timeout);
 gboolean sump_cmd_reset(gint fd);
 gboolean sump_cmd_id(gint fd, guint32 *ident);
 gboolean sump_cmd_set_trigger(gint fd, struct sump_trigger *trigger);
+
+/* The value of the configuration register of a trigger stage */
+guint32 sump_trigger_config(struct sump_trigger *trigger);
 gboolean sump_cmd_set_divider(gint fd, guint32 divider);
 gboolean sump_cmd_set_size(gint fd, guint16 read_count, guint16 delay_count);
 gboolean sump_cmd_set_flags(gint fd, guint32 flags);
@@ -60,5 +63,14 @@ void sump_dump_buffer(gsize size, gpointer buffer);
 #define SUMP_FLAG_EXTERNAL_CLOCK           0x00000040
 #define SUMP_FLAG_INVERT_EXTERNAL_CLOCK    0x00000080
 
+/* Fields of the trigger configuration register */
+#define SUMP_TRIGGER_DELAY_MASK            0x0000FFFF
+#define SUMP_TRIGGER_LEVEL_SHIFT           16
+#define SUMP_TRIGGER_LEVEL_MASK            0x00030000
+#define SUMP_TRIGGER_CHANNEL_SHIFT         20
+#define SUMP_TRIGGER_CHANNEL_MASK          0x01F00000
+#define SUMP_TRIGGER_SERIAL                0x04000000
+#define SUMP_TRIGGER_START                 0x08000000
+
 
 #endif /* _SUMP_H_ */
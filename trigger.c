@@ -27,39 +27,392 @@ typedef void* yyscan_t;
 #include "trigger_type.h"
 #include "trigger_parse.h"
 #include "trigger_lex.h"
-
-extern void *trigger_lex_setup_string(char *string);
-extern void trigger_lex_release_string(void *buffer);
+#include "probes.h"
 
 int yyparse(yyscan_t scanner,
 	    struct state *state,
 	    struct trigger_state *trigger_state);
 
-/* Will clear the triggers not used */
-gboolean trigger_compile(struct state *state)
+/* A compiled hardware trigger */
+struct image {
+	gchar *spec;
+	/* Time delays and signal names depend on these */
+	glong sample_rate;
+	guint64 layout;
+	struct sump_trigger triggers[NOOF_TRIGGERS];
+	gint noof_stages;
+};
+
+/*
+ * Every hardware trigger compiled so far, re-arming with one of them
+ * needs neither parsing nor allocation. The scanner is reused by all
+ * parses.
+ */
+static GPtrArray *images;
+static yyscan_t scanner;
+
+static gboolean parse(struct state *state, gchar *spec,
+		      struct trigger_state *trigger_state)
 {
 	gboolean status = FALSE;
-	yyscan_t scanner;
-	struct trigger_state trigger_state;
 	YY_BUFFER_STATE buffer;
 
-	trigger_state_init(state, &trigger_state);
+	if (scanner == NULL)
+		yylex_init_extra(state, &scanner);
+	else
+		yyset_extra(state, scanner);
+	buffer = yy_scan_string(spec, scanner);
+
+	if (yyparse(scanner, state, trigger_state) || !trigger_state->success)
+		goto error;
+	status = TRUE;
+error:
+	yy_delete_buffer(buffer, scanner);
+	return status;
+}
+
+/* FNV-1a hash of the names and channels of the signals */
+static guint64 signal_layout(struct state *state)
+{
+	guint64 h = 0xcbf29ce484222325ULL;
+
+	for (gint i = 0; i < state->noof_signals; i++) {
+		struct signal_def *signal = &state->signals[i];
+
+		for (const gchar *c = signal->name; *c; c++)
+			h = (h ^ (guchar)*c) * 0x100000001b3ULL;
+		for (gint bit = 0; bit < signal->noof_bits; bit++)
+			h = (h ^ (0x100 | signal->channels[bit]))
+				* 0x100000001b3ULL;
+		h = (h ^ 0x200) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static struct image *lookup_image(struct state *state, guint64 layout)
+{
+	for (guint i = 0; images != NULL && i < images->len; i++) {
+		struct image *image = g_ptr_array_index(images, i);
+
+		if (image->sample_rate == state->sample_rate
+		    && image->layout == layout
+		    && strcmp(image->spec, state->trigger_spec) == 0)
+			return image;
+	}
+	return NULL;
+}
+
+static gboolean same_shape(struct trigger *a, struct trigger *b)
+{
+	if (a->delay != b->delay || a->noof_steps != b->noof_steps)
+		return FALSE;
+	for (gint s = 0; s < a->noof_steps; s++)
+		if (a->steps[s].length != b->steps[s].length)
+			return FALSE;
+	return TRUE;
+}
+
+/* Return TRUE if every sequence matching a also matches b */
+static gboolean implies(struct trigger *a, struct trigger *b)
+{
+	if (!same_shape(a, b))
+		return FALSE;
+	for (gint s = 0; s < a->noof_steps; s++) {
+		struct trigger_pattern *pa = &a->steps[s].pattern;
+		struct trigger_pattern *pb = &b->steps[s].pattern;
+
+		if ((pb->mask & ~pa->mask)
+		    || ((pa->value ^ pb->value) & pb->mask))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * If a and b test the same channels and differ in a single channel in
+ * a single step, their union does not depend on that channel. Remove
+ * it from a and return TRUE.
+ */
+static gboolean merge_adjacent(struct trigger *a, struct trigger *b)
+{
+	gint step = -1;
+	guint64 diff = 0;
+
+	if (!same_shape(a, b))
+		return FALSE;
+	for (gint s = 0; s < a->noof_steps; s++) {
+		struct trigger_pattern *pa = &a->steps[s].pattern;
+		struct trigger_pattern *pb = &b->steps[s].pattern;
+		guint64 d = (pa->value ^ pb->value) & pa->mask;
+
+		if (pa->mask != pb->mask)
+			return FALSE;
+		if (d == 0)
+			continue;
+		if (step != -1)
+			return FALSE;
+		step = s;
+		diff = d;
+	}
+	if (step == -1 || (diff & (diff - 1)))
+		return FALSE;
+	a->steps[step].pattern.mask &= ~diff;
+	a->steps[step].pattern.value &= ~diff;
+	return TRUE;
+}
+
+/*
+ * Parallel triggers fire on any of their members, so a member which
+ * only matches when another one does is redundant, and two members
+ * which differ in a single channel can be replaced by one ignoring
+ * it. Repeat until no member can be removed.
+ */
+static void optimize_parallel(struct trigger_state *trigger_state)
+{
+	gboolean changed = TRUE;
+
+	while (changed) {
+		changed = FALSE;
+		for (GList *i = trigger_state->triggers;
+		     i != NULL && !changed; i = g_list_next(i)) {
+			for (GList *j = g_list_next(i);
+			     j != NULL && !changed; j = g_list_next(j)) {
+				GList *redundant = NULL;
+
+				if (implies(j->data, i->data)
+				    || merge_adjacent(i->data, j->data))
+					redundant = j;
+				else if (implies(i->data, j->data))
+					redundant = i;
+				if (redundant == NULL)
+					continue;
+				/* The link is freed with the arena */
+				trigger_state->triggers = g_list_remove_link(
+					trigger_state->triggers, redundant);
+				changed = TRUE;
+			}
+		}
+	}
+}
+
+static guint64 trigger_mask(struct trigger *trigger)
+{
+	guint64 mask = 0;
+
+	for (gint s = 0; s < trigger->noof_steps; s++)
+		mask |= trigger->steps[s].pattern.mask;
+	return mask;
+}
+
+static gint trigger_length(struct trigger *trigger)
+{
+	gint length = 0;
+
+	for (gint s = 0; s < trigger->noof_steps; s++)
+		length += trigger->steps[s].length;
+	return length;
+}
+
+/*
+ * A condition on a single sample needs one parallel hardware trigger,
+ * a longer sequence one serial hardware trigger per channel tested.
+ */
+static gint noof_hardware_triggers(struct trigger *trigger)
+{
+	if (trigger_length(trigger) == 1)
+		return 1;
+	return __builtin_popcountll(trigger_mask(trigger));
+}
+
+static struct sump_trigger *trigger_allocate_trigger(
+	struct trigger_state *state)
+{
+	if (state->noof_available == 0)
+		return NULL;
+
+	return &state->state->triggers[state->noof_available-- - 1];
+}
+
+static void allocate_parallel(struct trigger_state *trigger_state,
+			      struct trigger *trigger)
+{
+	struct sump_trigger *hw = trigger_allocate_trigger(trigger_state);
+
+	for (gint s = 0; s < trigger->noof_steps; s++) {
+		if (trigger->steps[s].length == 0)
+			continue;
+		hw->mask = trigger->steps[s].pattern.mask;
+		hw->values = trigger->steps[s].pattern.value;
+	}
+	hw->channel = 0;
+	hw->serial = FALSE;
+	hw->level = trigger->level;
+	hw->start = trigger->start;
+	hw->delay = trigger->delay;
+}
+
+/*
+ * Sample 0 of a serial trigger is the most recent one. A serial stage
+ * shifts in a single channel, so every channel of the trigger needs a
+ * stage of its own and timed triggers sharing their timing cannot be
+ * packed onto fewer stages.
+ */
+static void allocate_serial(struct trigger_state *trigger_state,
+			    struct trigger *trigger)
+{
+	guint64 mask = trigger_mask(trigger);
+
+	for (gint channel = 0; channel < NOOF_PHYSICAL_CHANNELS; channel++) {
+		guint64 bit = (guint64)1 << channel;
+		struct sump_trigger *hw;
+		gint sample = 0;
+
+		if (!(mask & bit))
+			continue;
+		hw = trigger_allocate_trigger(trigger_state);
+		for (gint s = trigger->noof_steps - 1; s >= 0; s--) {
+			struct trigger_step *step = &trigger->steps[s];
+
+			for (gint i = 0; i < step->length; i++, sample++) {
+				if (!(step->pattern.mask & bit))
+					continue;
+				hw->mask |= 1U << sample;
+				if (step->pattern.value & bit)
+					hw->values |= 1U << sample;
+			}
+		}
+		hw->channel = channel;
+		hw->serial = TRUE;
+		hw->level = trigger->level;
+		hw->start = trigger->start;
+		hw->delay = trigger->delay;
+	}
+}
+
+/* Fill in the hardware triggers of the state from the parsed triggers */
+static gboolean allocate(struct trigger_state *trigger_state)
+{
+	gint needed = 0;
+
+	for (GList *i = trigger_state->triggers; i != NULL;
+	     i = g_list_next(i)) {
+		struct trigger *trigger = i->data;
+
+		if (trigger_mask(trigger) >> NOOF_PHYSICAL_CHANNELS) {
+			if (trigger->signal != NULL)
+				fprintf(stderr,
+					"Error: Virtual signal %s cannot be "
+					"used in a hardware trigger\n",
+					trigger->signal->name);
+			else
+				fprintf(stderr,
+					"Error: Virtual signals cannot be used "
+					"in hardware triggers\n");
+			return FALSE;
+		}
+		if (trigger_length(trigger) > 32) {
+			fprintf(stderr,
+				"Error: Pattern sequence trigger for signal "
+				"%s describes a sequence of patterns extending"
+				" for more than 32 samples\n",
+				trigger->signal->name);
+			return FALSE;
+		}
+		needed += noof_hardware_triggers(trigger);
+	}
+	if (needed > trigger_state->noof_available) {
+		fprintf(stderr, "Error: Hardware triggers exhausted, the "
+			"trigger needs %d of the %d available\n",
+			needed, trigger_state->noof_available);
+		return FALSE;
+	}
+
+	for (GList *i = trigger_state->triggers; i != NULL;
+	     i = g_list_next(i)) {
+		struct trigger *trigger = i->data;
+
+		if (trigger_length(trigger) == 1)
+			allocate_parallel(trigger_state, trigger);
+		else
+			allocate_serial(trigger_state, trigger);
+	}
+
+	/*
+	 * An unused stage matches every sample, keep it at the last
+	 * level where it cannot advance the level of the used ones.
+	 */
+	for (gint i = 0; i < trigger_state->noof_available; i++)
+		trigger_state->state->triggers[i].level = NOOF_TRIGGERS - 1;
+	return TRUE;
+}
+
+/* Will clear the triggers not used */
+gboolean trigger_compile(struct state *state)
+{
+	struct trigger_state trigger_state;
+	guint64 layout;
+	struct image *image;
+	gboolean status;
 
 	if (state->trigger_spec == NULL) {
+		trigger_state_init(state, &trigger_state, FALSE);
 		for (gint i = 0; i < NOOF_TRIGGERS; i++)
 			state->triggers[i].start = TRUE;
+		state->noof_trigger_stages = 0;
+		return TRUE;
+	}
+
+	PROBE1(trigger__compile__start, state->trigger_spec);
+	layout = signal_layout(state);
+	image = lookup_image(state, layout);
+	if (image != NULL) {
+		memcpy(state->triggers, image->triggers,
+		       sizeof(state->triggers));
+		state->noof_trigger_stages = image->noof_stages;
+		PROBE2(trigger__compile__done, state->trigger_spec, 2);
 		return TRUE;
 	}
 
-	yylex_init_extra(state, &scanner);
-	buffer = yy_scan_string(state->trigger_spec, scanner);
+	trigger_state_init(state, &trigger_state, FALSE);
+	status = parse(state, state->trigger_spec, &trigger_state);
+	if (status && !trigger_state.sequential)
+		optimize_parallel(&trigger_state);
+	status = status && allocate(&trigger_state);
+	state->noof_trigger_stages = NOOF_TRIGGERS
+		- trigger_state.noof_available;
+	trigger_state_release(&trigger_state);
+	PROBE2(trigger__compile__done, state->trigger_spec, status);
+	/* Errors are not cached, so they are reported every time */
+	if (!status)
+		return FALSE;
 
-	if (yyparse(scanner, state, &trigger_state) || !trigger_state.success)
-		goto error;
-	status = TRUE;
-error:
-	yy_delete_buffer(buffer, scanner);
-	yylex_destroy(scanner);
-	return status;
+	image = g_malloc(sizeof(*image));
+	image->spec = g_strdup(state->trigger_spec);
+	image->sample_rate = state->sample_rate;
+	image->layout = layout;
+	memcpy(image->triggers, state->triggers, sizeof(image->triggers));
+	image->noof_stages = state->noof_trigger_stages;
+	if (images == NULL)
+		images = g_ptr_array_new();
+	g_ptr_array_add(images, image);
+	return TRUE;
 }
 
+void trigger_forget(void)
+{
+	for (guint i = 0; images != NULL && i < images->len; i++) {
+		struct image *image = g_ptr_array_index(images, i);
+
+		g_free(image->spec);
+		g_free(image);
+	}
+	if (images != NULL)
+		g_ptr_array_set_size(images, 0);
+}
+
+gboolean trigger_compile_software(struct state *state, gchar *spec,
+				  struct trigger_state *trigger_state)
+{
+	trigger_state_init(state, trigger_state, TRUE);
+	return parse(state, spec, trigger_state);
+}
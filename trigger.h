@@ -27,7 +27,22 @@
 #include <glib.h>
 #include "state.h"
 
+struct trigger_state;
+
 /* Will clear the triggers not used */
 gboolean trigger_compile(struct state *state);
 
+/*
+ * Forget the triggers compiled so far, the next trigger_compile() of
+ * any specification parses and allocates it again.
+ */
+void trigger_forget(void);
+
+/*
+ * Parse spec without allocating any hardware triggers, the parsed
+ * triggers are left in trigger_state.
+ */
+gboolean trigger_compile_software(struct state *state, gchar *spec,
+				  struct trigger_state *trigger_state);
+
 #endif /* _TRIGGER_H_ */
@@ -82,32 +82,35 @@ typedef void* yyscan_t;
 
 triggers: sequential_triggers
 | parallel_triggers
-| delayed_trigger { trigger_activate($1, 0, TRUE); }
+| delayed_trigger {
+  trigger_activate_sequential_list(
+    trigger_state, trigger_list_append(trigger_state, NULL, $1));
+}
         ;
 
 sequential_triggers: LPARA sequential_trigger_list RPARA {
-  trigger_activate_sequential_list($2);
+  trigger_activate_sequential_list(trigger_state, $2);
 }
 ;
 
 parallel_triggers: LBRACE parallel_trigger_list RBRACE {
-  trigger_activate_parallel_list($2);
+  trigger_activate_parallel_list(trigger_state, $2);
 }
 ;
 
 sequential_trigger_list: sequential_trigger_list COMMA trigger {
-  $$ = g_list_append($1, $3);
+  $$ = trigger_list_append(trigger_state, $1, $3);
 }
 | delayed_trigger {
-  $$ = g_list_append(NULL, $1);
+  $$ = trigger_list_append(trigger_state, NULL, $1);
 }
 ;
 
 parallel_trigger_list: parallel_trigger_list COMMA trigger {
-  $$ = g_list_append($1, $3);
+  $$ = trigger_list_append(trigger_state, $1, $3);
 }
 | delayed_trigger {
-  $$ = g_list_append(NULL, $1);
+  $$ = trigger_list_append(trigger_state, NULL, $1);
 }
 ;
 
@@ -155,10 +158,10 @@ timed_values_list: timed_values_list COMMA timed_value {
 ;
 
 timed_value: VALUE TIME {
-  $$ = trigger_make_timed_value(state, $1, $2);
+  $$ = trigger_make_timed_value(trigger_state, $1, $2);
  }
 | VALUE SAMPLE_CNT {
-  $$ = trigger_make_delayed_value($1, $2);
+  $$ = trigger_make_delayed_value(trigger_state, $1, $2);
 }
 ;
 
@@ -167,6 +170,11 @@ pattern_trigger_spec: LBRACKET pattern_trigger_list RBRACKET {
 };
 
 pattern_trigger_list: pattern_trigger_list COMMA pattern_trigger {
+  if (!trigger_pattern_compatible($1, $3)) {
+    fprintf(stderr, "Error: Pattern trigger requires a signal to take "
+	    "two different values\n");
+    trigger_state->success = FALSE;
+  }
   $$ = trigger_pattern_merge($1, $3);
 }
 | pattern_trigger
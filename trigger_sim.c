@@ -0,0 +1,223 @@
+/* -*- linux-c -*-
+ *
+ * Simulation of the hardware trigger
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "trigger_sim.h"
+#include "trigger.h"
+#include "sump.h"
+
+enum stage_state {
+	STAGE_OFF,
+	STAGE_ARMED,
+	STAGE_MATCHED
+};
+
+/* One trigger stage, decoded from its registers as the hardware does */
+struct stage {
+	guint32 mask;
+	guint32 values;
+	gint delay;
+	gint level;
+	gint channel;
+	gboolean serial;
+	gboolean start;
+	/* The samples at which the mask and values match */
+	guint64 *match;
+	enum stage_state state;
+	gint fire; /* The sample at which a matched stage fires */
+};
+
+struct capture *trigger_sim_synthetic(struct state *state)
+{
+	gint n = state_buffer_capacity(state);
+	sample_t *samples = g_malloc(n * sizeof(*samples));
+
+	for (gint t = 0; t < n; t++)
+		samples[t] = (guint32)t;
+	return capture_new_from_samples(state, samples, n, 0);
+}
+
+/* Plane of the samples where the channel has the given value */
+static guint64 *level_plane(guint64 **planes, struct capture *capture,
+			    gint channel, gboolean value, gint words)
+{
+	guint64 *r = g_malloc(words * sizeof(*r));
+
+	if (planes[channel] == NULL)
+		planes[channel] = capture_bitplane(capture, channel);
+	for (gint w = 0; w < words; w++)
+		r[w] = value ? planes[channel][w] : ~planes[channel][w];
+	return r;
+}
+
+/*
+ * In parallel mode bit c of the mask tests channel c of the current
+ * sample. In serial mode the samples of one channel are shifted in,
+ * bit k tests it k samples back, and it cannot match until the shift
+ * register holds samples of the capture for every bit of the mask.
+ */
+static void match_stage(struct stage *stage, guint64 **planes,
+			struct capture *capture)
+{
+	gint n = capture->noof_samples;
+	gint words = MAX((n + 63) / 64, 1);
+	guint64 *shifted = g_malloc(words * sizeof(*shifted));
+
+	stage->match = g_malloc(words * sizeof(*stage->match));
+	memset(stage->match, 0xFF, words * sizeof(*stage->match));
+	for (gint bit = 0; bit < 32; bit++) {
+		gint channel = stage->serial ? stage->channel : bit;
+		gboolean value = (stage->values >> bit) & 1;
+		guint64 *p;
+
+		if (!((stage->mask >> bit) & 1))
+			continue;
+		p = level_plane(planes, capture, channel, value, words);
+		if (stage->serial) {
+			memset(shifted, 0, words * sizeof(*shifted));
+			capture_bitplane_shift_or(shifted, p, words, bit);
+			memcpy(p, shifted, words * sizeof(*p));
+		}
+		for (gint w = 0; w < words; w++)
+			stage->match[w] &= p[w];
+		g_free(p);
+	}
+	if (n % 64)
+		stage->match[words - 1] &= ((guint64)1 << (n % 64)) - 1;
+	g_free(shifted);
+}
+
+static void arm(struct stage *stages)
+{
+	for (gint i = 0; i < NOOF_TRIGGERS; i++)
+		stages[i].state = STAGE_ARMED;
+}
+
+/*
+ * Run the stages from sample from. An armed stage whose level is at
+ * most the current level matches, and fires delay samples later. A
+ * firing stage is turned off and either starts the capture or raises
+ * the level by one from the next sample. Return the sample at which
+ * the capture starts, n if it does not.
+ */
+static gint run_stages(struct stage *stages, gint n, gint from)
+{
+	gint level = 0;
+
+	arm(stages);
+	for (gint t = from; t < n; t++) {
+		gboolean advance = FALSE;
+		gboolean start = FALSE;
+		gint next = n;
+
+		/* Skip to the next sample where something happens */
+		for (gint i = 0; i < NOOF_TRIGGERS; i++) {
+			struct stage *s = &stages[i];
+
+			if (s->state == STAGE_ARMED && s->level <= level)
+				next = MIN(next, capture_bitplane_find(
+						   s->match, n, t, TRUE));
+			else if (s->state == STAGE_MATCHED)
+				next = MIN(next, s->fire);
+		}
+		if (next >= n)
+			break;
+		t = next;
+
+		for (gint i = 0; i < NOOF_TRIGGERS; i++) {
+			struct stage *s = &stages[i];
+
+			if (s->state == STAGE_ARMED && s->level <= level
+			    && (s->match[t / 64] >> (t % 64)) & 1) {
+				s->state = STAGE_MATCHED;
+				s->fire = t + s->delay;
+			}
+			if (s->state != STAGE_MATCHED || s->fire != t)
+				continue;
+			s->state = STAGE_OFF;
+			if (s->start)
+				start = TRUE;
+			else
+				advance = TRUE;
+		}
+		if (start)
+			return t;
+		if (advance)
+			level = MIN(level + 1, NOOF_TRIGGERS - 1);
+	}
+	return n;
+}
+
+static void decode_stage(struct stage *stage, struct sump_trigger *trigger)
+{
+	guint32 config = sump_trigger_config(trigger);
+
+	stage->mask = trigger->mask;
+	stage->values = trigger->values;
+	stage->delay = config & SUMP_TRIGGER_DELAY_MASK;
+	stage->level = (config & SUMP_TRIGGER_LEVEL_MASK)
+		>> SUMP_TRIGGER_LEVEL_SHIFT;
+	stage->channel = (config & SUMP_TRIGGER_CHANNEL_MASK)
+		>> SUMP_TRIGGER_CHANNEL_SHIFT;
+	stage->serial = (config & SUMP_TRIGGER_SERIAL) != 0;
+	stage->start = (config & SUMP_TRIGGER_START) != 0;
+	printf("Stage %u: mask 0x%08x, values 0x%08x, config 0x%08x\n",
+	       trigger->trigger, trigger->mask, trigger->values, config);
+}
+
+gboolean trigger_sim_run(struct state *state, struct capture *capture,
+			 gboolean *fired)
+{
+	struct stage stages[NOOF_TRIGGERS];
+	guint64 *planes[NOOF_PHYSICAL_CHANNELS] = { NULL };
+	gint n = capture->noof_samples;
+	gint noof_fired = 0;
+
+	if (!trigger_compile(state)) {
+		fprintf(stderr, "Failed to compile trigger\n");
+		return FALSE;
+	}
+
+	for (gint i = 0; i < NOOF_TRIGGERS; i++) {
+		decode_stage(&stages[i], &state->triggers[i]);
+		match_stage(&stages[i], planes, capture);
+	}
+
+	for (gint t = run_stages(stages, n, 0); t < n;
+	     t = run_stages(stages, n, t + 1)) {
+		printf("Fires at sample %d\n", t - capture->trigger);
+		noof_fired++;
+	}
+
+	*fired = noof_fired > 0;
+	if (*fired)
+		printf("Fired %d times in %d samples\n", noof_fired, n);
+	else
+		printf("Did not fire in %d samples\n", n);
+
+	for (gint i = 0; i < NOOF_TRIGGERS; i++)
+		g_free(stages[i].match);
+	for (gint i = 0; i < NOOF_PHYSICAL_CHANNELS; i++)
+		g_free(planes[i]);
+	return TRUE;
+}
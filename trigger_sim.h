@@ -0,0 +1,47 @@
+/* -*- linux-c -*-
+ *
+ * Simulation of the hardware trigger
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _TRIGGER_SIM_H_
+#define _TRIGGER_SIM_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+/*
+ * A synthetic stream of as many samples as the device would capture,
+ * the physical channels of sample t count t in binary.
+ */
+struct capture *trigger_sim_synthetic(struct state *state);
+
+/*
+ * Compile the hardware trigger of the state and run the trigger
+ * stages as programmed into the device over the capture, re-arming
+ * them each time the trigger fires. The register image and every
+ * firing, counted from the trigger point of the capture, are written
+ * to stdout. fired tells if the trigger fired at all.
+ */
+gboolean trigger_sim_run(struct state *state, struct capture *capture,
+			 gboolean *fired);
+
+#endif /* _TRIGGER_SIM_H_ */
@@ -25,6 +25,50 @@
 #include <string.h>
 #include "trigger_type.h"
 
+#define ARENA_BLOCK_SIZE 4096
+
+struct trigger_arena_block {
+	struct trigger_arena_block *next;
+	gsize size;
+	gsize used;
+	guint64 data[]; /* For the alignment */
+};
+
+gpointer trigger_alloc(struct trigger_state *trigger_state, gsize size)
+{
+	struct trigger_arena_block *block = trigger_state->arena;
+	gpointer r;
+
+	size = (size + sizeof(guint64) - 1) & ~(sizeof(guint64) - 1);
+	if (block == NULL || block->used + size > block->size) {
+		gsize block_size = MAX(size, ARENA_BLOCK_SIZE);
+
+		block = g_malloc(sizeof(*block) + block_size);
+		block->next = trigger_state->arena;
+		block->size = block_size;
+		block->used = 0;
+		trigger_state->arena = block;
+	}
+	r = (guint8 *)block->data + block->used;
+	block->used += size;
+	memset(r, 0, size);
+	return r;
+}
+
+GList *trigger_list_append(struct trigger_state *trigger_state,
+			   GList *list, gpointer data)
+{
+	GList *link = trigger_alloc(trigger_state, sizeof(*link));
+	GList *last = g_list_last(list);
+
+	link->data = data;
+	if (last == NULL)
+		return link;
+	last->next = link;
+	link->prev = last;
+	return list;
+}
+
 struct trigger_pattern trigger_pattern_merge(
 	struct trigger_pattern a,
 	struct trigger_pattern b)
@@ -46,34 +90,22 @@ struct trigger_pattern trigger_pattern_make(struct signal_def *signal,
 	return r;
 }
 
-static struct sump_trigger *trigger_allocate_trigger(
-	struct trigger_state *state)
+gboolean trigger_pattern_compatible(struct trigger_pattern a,
+				    struct trigger_pattern b)
 {
-	if (state->noof_available == 0)
-		return NULL;
-
-	return &state->state->triggers[state->noof_available-- - 1];
+	return ((a.value ^ b.value) & a.mask & b.mask) == 0;
 }
 
 struct trigger *trigger_make_pattern_trigger(
 	struct trigger_state *trigger_state,
 	struct trigger_pattern pattern)
 {
-	struct trigger *r = g_malloc(sizeof(*r));
+	struct trigger *r = trigger_alloc(trigger_state, sizeof(*r));
 
-	r->noof_triggers = 1;
- 	r->triggers = g_malloc(r->noof_triggers * sizeof(*r->triggers));
-	r->triggers[0] = trigger_allocate_trigger(trigger_state);
-	if (r->triggers[0] == NULL) {
-			fprintf(stderr,	"Error: Hardware triggers exhausted\n");
-			trigger_state->success = FALSE;
-			return r;
-	}
-
-	r->triggers[0]->mask = pattern.mask;
-	r->triggers[0]->values = pattern.value;
-	r->triggers[0]->channel = 0;
-	r->triggers[0]->serial = FALSE;
+	r->noof_steps = 1;
+	r->steps = trigger_alloc(trigger_state, sizeof(*r->steps));
+	r->steps[0].pattern = pattern;
+	r->steps[0].length = 1;
 	return r;
 }
 
@@ -86,7 +118,7 @@ struct trigger *trigger_add_time_delay(struct state *state,
 
 	trigger->delay = state->sample_rate * delay;
 
-	if (trigger->delay > MAX_SAMPLE_DELAY) {
+	if (trigger->delay > MAX_SAMPLE_DELAY && !trigger_state->software) {
 		fprintf(stderr,
 			"Error: Time delay of %es exceeds hardware"
 			" capabilities.\n",
@@ -107,7 +139,7 @@ struct trigger *trigger_add_time_delay(struct state *state,
 struct trigger *trigger_add_sample_delay(struct trigger_state *trigger_state,
 					 struct trigger *trigger, gint delay)
 {
-	if (delay > MAX_SAMPLE_DELAY) {
+	if (delay > MAX_SAMPLE_DELAY && !trigger_state->software) {
 		fprintf(stderr,
 			"Error: Sample delay of %d exceeds hardware "
 			" capabilities\n",
@@ -120,10 +152,12 @@ struct trigger *trigger_add_sample_delay(struct trigger_state *trigger_state,
 }
 
 struct trigger_timed_value *trigger_make_timed_value(
-	struct state *state,
+	struct trigger_state *trigger_state,
 	guint32 value, gdouble delay)
 {
-	struct trigger_timed_value *r = g_malloc(sizeof(*r));
+	struct state *state = trigger_state->state;
+	struct trigger_timed_value *r = trigger_alloc(trigger_state,
+						      sizeof(*r));
 	gdouble sample_period = 1.0 / (double)state->sample_rate;
 
 	r->delay = state->sample_rate * delay;
@@ -140,9 +174,11 @@ struct trigger_timed_value *trigger_make_timed_value(
 }
 
 struct trigger_timed_value *trigger_make_delayed_value(
+	struct trigger_state *trigger_state,
 	guint32 value, gint delay)
 {
-	struct trigger_timed_value *r = g_malloc(sizeof(*r));
+	struct trigger_timed_value *r = trigger_alloc(trigger_state,
+						      sizeof(*r));
 
 	r->delay = delay;
 	r->value = value;
@@ -153,81 +189,64 @@ struct trigger *trigger_make_timed_trigger(struct trigger_state *trigger_state,
 					   struct signal_def *signal,
 					   struct trigger_timed_value *values)
 {
-	struct trigger *r = g_malloc(sizeof(*r));
-	gint bit = 0;
-
-	r->noof_triggers = signal->noof_bits;
- 	r->triggers = g_malloc(r->noof_triggers * sizeof(*r->triggers));
-
-	for (GList *i = signal->channels;
-	     i != NULL;
-	     i = g_list_next(i), bit++) {
-		gint channel = GPOINTER_TO_INT(i->data);
-		struct sump_trigger *trigger =
-			trigger_allocate_trigger(trigger_state);
-		gint sample = 0;
-
-		r->triggers[bit] = trigger;
-		if (trigger == NULL) {
-			fprintf(stderr,
-				"Error: Pattern sequence trigger for signal %s "
-				"requires more than the available number of "
-				"hardware triggers\n",
-				signal->name);
-			trigger_state->success = FALSE;
-			return r;
-		}
-		trigger->channel = channel;
-		trigger->serial = TRUE;
-		for (struct trigger_timed_value *value = values;
-		     value != NULL;
-		     value = value->next) {
-			for (gint index = 0; index < value->delay; index++) {
-				trigger->mask |= (1 << (sample + index));
-				if (value->value & (1 << bit))
-					trigger->values |= (1 << (sample + index));
-			}
-			sample += value->delay;
-		}
-		if (sample > 32) {
-			fprintf(stderr,
-				"Error: Pattern sequence trigger for signal "
-				"%s describes a sequence of patterns extending"
-				" for more than 32 samples\n",
-				signal->name);
-			trigger_state->success = FALSE;
-			return r;
-		}
+	struct trigger *r = trigger_alloc(trigger_state, sizeof(*r));
+	gint step;
+
+	/* The values are listed with the most recent first */
+	for (struct trigger_timed_value *value = values;
+	     value != NULL;
+	     value = value->next)
+		r->noof_steps++;
+	r->steps = trigger_alloc(trigger_state,
+				 r->noof_steps * sizeof(*r->steps));
+	step = r->noof_steps;
+	for (struct trigger_timed_value *value = values;
+	     value != NULL;
+	     value = value->next) {
+		step--;
+		r->steps[step].pattern = trigger_pattern_make(signal,
+							      value->value);
+		r->steps[step].length = value->delay;
 	}
+	r->signal = signal;
 	return r;
 }
 
 void trigger_state_init(struct state *state,
-			struct trigger_state *trigger_state)
+			struct trigger_state *trigger_state,
+			gboolean software)
 {
 	trigger_state->state = state;
 	trigger_state->noof_available = NOOF_TRIGGERS;
 	trigger_state->success = TRUE;
+	trigger_state->software = software;
+	trigger_state->triggers = NULL;
+	trigger_state->sequential = TRUE;
+	trigger_state->arena = NULL;
+	if (software)
+		return;
 	memset(state->triggers, 0, sizeof(*state->triggers) * NOOF_TRIGGERS);
-
+	for (gint i = 0; i < NOOF_TRIGGERS; i++)
+		state->triggers[i].trigger = i;
 }
 
 struct trigger *trigger_activate(struct trigger *trigger,
 				 gint level, gboolean start)
 {
-	for (gint i = 0; i < trigger->noof_triggers; i++) {
-		trigger->triggers[i]->level = level;
-		trigger->triggers[i]->start = start;
-		trigger->triggers[i]->delay = trigger->delay;
-	}
+	trigger->level = level;
+	trigger->start = start;
 	return trigger;
 }
 
 
 /* triggers is a list of struct trigger * */
-void trigger_activate_sequential_list(GList *triggers)
+void trigger_activate_sequential_list(struct trigger_state *trigger_state,
+				      GList *triggers)
 {
 	gint level = 0;
+
+	trigger_state->triggers = triggers;
+	trigger_state->sequential = TRUE;
 	for (GList *i = triggers; i != NULL; i = g_list_next(i), level++) {
 		struct trigger *trigger = i->data;
 
@@ -237,12 +256,26 @@ void trigger_activate_sequential_list(GList *triggers)
 }
 
 /* triggers is a list of struct trigger * */
-void trigger_activate_parallel_list(GList *triggers)
+void trigger_activate_parallel_list(struct trigger_state *trigger_state,
+				    GList *triggers)
 {
+	trigger_state->triggers = triggers;
+	trigger_state->sequential = FALSE;
 	for (GList *i = triggers; i != NULL; i = g_list_next(i)) {
 		struct trigger *trigger = i->data;
 
-		trigger_activate(trigger, 0, g_list_next(i) == NULL);
+		trigger_activate(trigger, 0, TRUE);
+	}
+}
+
+void trigger_state_release(struct trigger_state *trigger_state)
+{
+	while (trigger_state->arena != NULL) {
+		struct trigger_arena_block *next = trigger_state->arena->next;
+
+		g_free(trigger_state->arena);
+		trigger_state->arena = next;
 	}
+	trigger_state->triggers = NULL;
 }
 
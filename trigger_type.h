@@ -29,13 +29,29 @@
 
 struct trigger_state {
 	gboolean success;
+	/*
+	 * A software trigger is evaluated over the captured samples,
+	 * it does not use any hardware triggers and has none of their
+	 * limits.
+	 */
+	gboolean software;
 	gint noof_available;
 	struct state *state;
+
+	/* The top level triggers, struct trigger * */
+	GList *triggers;
+	gboolean sequential;
+
+	/*
+	 * Everything built while parsing is allocated from the arena
+	 * and released together by trigger_state_release().
+	 */
+	struct trigger_arena_block *arena;
 };
 
 struct trigger_pattern {
-	guint32 value;
-	guint32 mask;
+	guint64 value;
+	guint64 mask;
 };
 
 struct trigger_timed_value {
@@ -45,12 +61,31 @@ struct trigger_timed_value {
 	guint32 value;
 };
 
+/* A pattern which holds for a number of consecutive samples */
+struct trigger_step {
+	struct trigger_pattern pattern;
+	gint length; /* In samples */
+};
+
 struct trigger {
 	gint delay; /* In samples */
-	gint noof_triggers;
-	struct sump_trigger **triggers;
+	/* Hardware triggers are allocated for the trigger at this level */
+	gint level;
+	gboolean start;
+	/* The signal of a timed trigger, NULL for a pattern trigger */
+	struct signal_def *signal;
+	/* The condition as a sequence of steps, oldest first */
+	gint noof_steps;
+	struct trigger_step *steps;
 };
 
+/* Zeroed memory which lives until the trigger state is released */
+gpointer trigger_alloc(struct trigger_state *trigger_state, gsize size);
+
+/* As g_list_append() with the new link allocated from the arena */
+GList *trigger_list_append(struct trigger_state *trigger_state,
+			   GList *list, gpointer data);
+
 struct trigger_pattern trigger_pattern_make(struct signal_def *signal,
 					    guint32 value);
 
@@ -58,6 +93,10 @@ struct trigger_pattern trigger_pattern_merge(
 	struct trigger_pattern a,
 	struct trigger_pattern b);
 
+/* Return FALSE if no sample can match both a and b */
+gboolean trigger_pattern_compatible(struct trigger_pattern a,
+				    struct trigger_pattern b);
+
 struct trigger *trigger_make_pattern_trigger(
 	struct trigger_state *trigger_state,
 	struct trigger_pattern pattern);
@@ -72,10 +111,11 @@ struct trigger *trigger_add_sample_delay(struct trigger_state *trigger_state,
 					 gint delay);
 
 struct trigger_timed_value *trigger_make_timed_value(
-	struct state *state,
+	struct trigger_state *trigger_state,
 	guint32 value, gdouble delay);
 
 struct trigger_timed_value *trigger_make_delayed_value(
+	struct trigger_state *trigger_state,
 	guint32 value, gint delay);
 
 struct trigger *trigger_make_timed_trigger(struct trigger_state *trigger_state,
@@ -83,13 +123,19 @@ struct trigger *trigger_make_timed_trigger(struct trigger_state *trigger_state,
 					   struct trigger_timed_value *values);
 
 void trigger_state_init(struct state *state,
-			struct trigger_state *trigger_state);
+			struct trigger_state *trigger_state,
+			gboolean software);
 
 struct trigger *trigger_activate(struct trigger *trigger,
 				 gint level, gboolean start);
 
 /* triggers is a list of struct trigger * */
-void trigger_activate_sequential_list(GList *triggers);
-void trigger_activate_parallel_list(GList *triggers);
+void trigger_activate_sequential_list(struct trigger_state *trigger_state,
+				      GList *triggers);
+void trigger_activate_parallel_list(struct trigger_state *trigger_state,
+				    GList *triggers);
+
+/* Free everything allocated for the parsed triggers */
+void trigger_state_release(struct trigger_state *trigger_state);
 
 #endif /* _TRIGGER_TYPE_H_ */
@@ -23,195 +23,202 @@
 #include <stdio.h>
 #include "time.h"
 #include "vcd.h"
+#include "output.h"
+
+/* Enough for the identifier of any signal index */
+#define VCD_ID_SIZE 8
 
 struct vcd_state {
 	struct state *state;
-	FILE *out;
-	guint8 *samples;
+	struct output *out;
+	struct capture *capture;
 	gdouble timescale;
+	/* The identifier code of each signal, by index */
+	gchar (*ids)[VCD_ID_SIZE];
 };
 
+/*
+ * Identifier codes are strings of the printable characters '!' to
+ * '~', the index is written in base 94 with the least significant
+ * digit first.
+ */
+static void make_id(gint index, gchar *id)
+{
+	do {
+		*id++ = '!' + index % 94;
+		index /= 94;
+	} while (index > 0);
+	*id = 0;
+}
+
 static void signal_def(struct vcd_state *state, struct signal_def* signal)
 {
-	fprintf(state->out, "$var wire %d %c %s $end\n",
-		signal->noof_bits, signal->index + '!', signal->name);
+	output_printf(state->out, "$var wire %d %s %s $end\n",
+		      signal->noof_bits, state->ids[signal->index],
+		      signal->name);
+}
+
+void vcd_timescale(struct state *state, gint *exponent, gint *multiplier)
+{
+	double sample_time = 1.0/state->sample_rate;
+
+	/* We want at least three decimals for each sample */
+	if (state->sample_rate > 1000000) {
+		*exponent = -12;
+		*multiplier = 1e12*sample_time;
+	} else if (state->sample_rate > 1000) {
+		*exponent = -9;
+		*multiplier = 1e9*sample_time;
+	} else {
+		*exponent = -6;
+		*multiplier = 1e6*sample_time;
+	}
 }
 
 static gboolean write_header(struct vcd_state *state)
 {
 	time_t t = time(NULL);
-	double sample_time = 1.0/state->state->sample_rate;
+	gint exponent, multiplier;
 
-	fprintf(state->out, "$date\n  %s$end\n", ctime(&t));
-	fprintf(state->out,
-		"$version\n  Open bench logic sniffer capture tool v"
-		VERSION_STRING"\n$end\n");
+	output_printf(state->out, "$date\n  %s$end\n", ctime(&t));
+	output_printf(state->out,
+		      "$version\n  Open bench logic sniffer capture tool v"
+		      VERSION_STRING"\n$end\n");
 
 	/* Dump triggers and arguments in a comment */
-	fprintf(state->out, "$comment\n");
-	fprintf(state->out, "  Sample rate %ld Hz\n",
-		state->state->sample_rate);
-	fprintf(state->out, "  Number of samples %d\n",
-		state_buffer_capacity(state->state));
-	fprintf(state->out, "$end\n");
-
-	/* We want at least three decimals for each sample */
-	if (state->state->sample_rate > 1000000)
-		fprintf(state->out, "$timescale %dps $end\n",
-			(int)(1e12*sample_time));
-	else if (state->state->sample_rate > 1000)
-		fprintf(state->out, "$timescale %dns $end\n",
-			(int)(1e9*sample_time));
-	else
-		fprintf(state->out, "$timescale %dus $end\n",
-			(int)(1e6*sample_time));
-
-	fprintf(state->out, "$scope module logic $end\n");
+	output_printf(state->out, "$comment\n");
+	output_printf(state->out, "  Sample rate %ld Hz\n",
+		      state->state->sample_rate);
+	output_printf(state->out, "  Number of samples %d\n",
+		      state->capture->noof_samples);
+	output_printf(state->out, "$end\n");
+
+	vcd_timescale(state->state, &exponent, &multiplier);
+	output_printf(state->out, "$timescale %d%s $end\n", multiplier,
+		      exponent == -12 ? "ps" : exponent == -9 ? "ns" : "us");
+
+	output_printf(state->out, "$scope module logic $end\n");
 	/* Wires here */
-	for (GList *i = g_list_first(state->state->signals);
-	     i != NULL;
-	     i = g_list_next(i)) {
-		signal_def(state, (struct signal_def*) i->data);
-	}
-	if (state->state->trigger_spec != NULL)
-		fprintf(state->out, "$var event 1 trigg obls_trigger $end\n");
-	fprintf(state->out, "$upscope $end\n");
-	fprintf(state->out, "$enddefinitions $end\n");
+	for (gint i = 0; i < state->state->noof_signals; i++)
+		signal_def(state, &state->state->signals[i]);
+	if (state->state->trigger_spec != NULL
+	    || state->state->soft_trigger_spec != NULL)
+		output_printf(state->out,
+			      "$var event 1 trigg obls_trigger $end\n");
+	output_printf(state->out, "$upscope $end\n");
+	output_printf(state->out, "$enddefinitions $end\n");
 
 	return TRUE;
 }
 
-static guint32 make_channels_mask(struct signal_def *s)
+static void dump_value(struct vcd_state *state,
+		       sample_t sample,
+		       struct signal_def *signal)
 {
-	guint32 r = 0;
+	guint32 v = capture_signal_value(signal, sample);
+	gint index = signal->noof_bits;
 
-	for (GList *i = g_list_first(s->channels);
-	     i != NULL;
-	     i = g_list_next(i)) {
-		r |= (1 << GPOINTER_TO_INT(i->data));
+	if (index == 1)
+		output_printf(state->out, "%d%s\n", v,
+			      state->ids[signal->index]);
+	else {
+		output_putc(state->out, 'b');
+		for (; index >= 0; index--)
+			output_putc(state->out, (v & (1 << index)) ? '1' : '0');
+		output_printf(state->out, " %s\n", state->ids[signal->index]);
 	}
-	return r;
 }
 
-static guint32 unpack_sample(guint32 channels_in_use, guint8 *samples)
+gint vcd_next_dump_point(struct capture *capture, gint after,
+			 gint *change, sample_t *diff)
 {
-	guint32 v = 0;
-
-	if (channels_in_use & 0x000000FF)
-		v |= *samples--;
-	if (channels_in_use & 0x0000FF00)
-		v |= (*samples-- << 8);
-	if (channels_in_use & 0x00FF0000) {
-		v |= (*samples-- << 16);
-		samples--;
-	}
-	if (channels_in_use & 0xFF000000)
-		v |= (*samples-- << 24);
-	return v;
+	gint next = capture->noof_samples - 1;
+
+	*diff = 0;
+	if (*change < capture->noof_changes
+	    && capture->changes[*change].sample < next)
+		next = capture->changes[*change].sample;
+	if (capture->trigger > after && capture->trigger < next)
+		next = capture->trigger;
+	if (next <= after)
+		return -1;
+	if (*change < capture->noof_changes
+	    && capture->changes[*change].sample == next)
+		*diff = capture->changes[(*change)++].diff;
+	return next;
 }
 
-static void dump_value(struct vcd_state *state,
-		       guint32 sample,
-		       struct signal_def *signal)
+static void dump_values(struct vcd_state *state)
 {
-	guint32 v = 0;
-	gint index = 0;
-
-	for (GList *i = g_list_first(signal->channels);
-	     i != NULL;
-	     i = g_list_next(i), index++) {
-		if (sample & (1 << GPOINTER_TO_INT(i->data)))
-			v |= (1 << index);
-	}
-	if (index == 1)
-		fprintf(state->out, "%d%c\n", v, '!' + signal->index);
-	else {
-		fprintf(state->out, "b");
-		for (; index >= 0; index--) {
-			if (v & (1 << index))
-				fprintf(state->out, "1");
-			else
-				fprintf(state->out, "0");
-		}
-		fprintf(state->out, " %c\n", '!' + signal->index);
+	struct capture *capture = state->capture;
+	struct signal_def *signals = state->state->signals;
+	gint noof_signals = state->state->noof_signals;
+	gint change = 0;
+	sample_t diff;
+
+	output_printf(state->out, "$dumpvars\n");
+	/* Initial values here */
+	for (gint s = 0; s < noof_signals; s++)
+		dump_value(state, capture->samples[0], &signals[s]);
+	output_printf(state->out, "$end\n");
+
+	for (gint i = 0;
+	     (i = vcd_next_dump_point(capture, i, &change, &diff)) != -1;) {
+		output_printf(state->out, "#%d\n", i);
+		if (i == capture->trigger)
+			output_printf(state->out, "1trigg\n");
+		for (gint s = 0; s < noof_signals; s++)
+			if (signals[s].mask & diff)
+				dump_value(state, capture->samples[i],
+					   &signals[s]);
 	}
 }
 
-static void dump_values(struct vcd_state *state)
+/*
+ * Estimate the size of the dump from the edge index, assuming that
+ * every edge of a channel results in a value line for its signal.
+ */
+static gsize estimate_size(struct vcd_state *state)
 {
-	gint noof_samples = state_buffer_capacity(state->state);
-	/* A bit set to '1' in the word at index 'n' means that the
-	   signal with index 'n' depends on the channel */
-	guint32 channels_mask[state->state->noof_signals];
-	guint32 current_sample, previous_sample;
-	gint noof_groups = state_noof_channel_groups_in_use(state->state);
-
-	current_sample = unpack_sample(
-		state->state->channels_in_use,
-		state->samples + noof_samples * noof_groups);
-	fprintf(state->out, "$dumpvars\n");
-	/* Initial values here */
-	for (GList *i = g_list_first(state->state->signals);
-	     i != NULL;
-	     i = g_list_next(i)) {
-		struct signal_def *s = i->data;
+	struct capture *capture = state->capture;
+	gsize size = 1024 + 64 * state->state->noof_signals;
 
-		channels_mask[s->index] = make_channels_mask(s);
-		dump_value(state, current_sample, s);
-	}
-	fprintf(state->out, "$end\n");
-
-	for (gint i = 1; i < noof_samples; i++) {
-		guint32 diff;
-
-		previous_sample = current_sample;
-		current_sample = unpack_sample(
-			state->state->channels_in_use,
-			state->samples + (noof_samples - i) * noof_groups);
-		diff = previous_sample ^ current_sample;
-
-		if (!(diff & state->state->channels_in_use) &&
-		    i != state->state->trigger_holdoff &&
-		    i != (noof_samples - 1))
-			continue;
-		fprintf(state->out, "#%d\n", i);
-		if (i == state->state->trigger_holdoff)
-			fprintf(state->out, "1trigg\n");
-		for (GList *sig = g_list_first(state->state->signals);
-		     sig != NULL;
-		     sig = g_list_next(sig)) {
-			struct signal_def *s = sig->data;
-
-			if (channels_mask[s->index] & diff)
-				dump_value(state, current_sample, s);
-		}
+	size += (gsize)capture->noof_changes * 10;
+	for (gint i = 0; i < state->state->noof_signals; i++) {
+		struct signal_def *s = &state->state->signals[i];
 
+		for (gint bit = 0; bit < s->noof_bits; bit++)
+			size += (gsize)capture->noof_edges[s->channels[bit]]
+				* (s->noof_bits + 5);
 	}
-
+	return size;
 }
 
-gboolean vcd_dump(struct state *state, guint8 *samples)
+gboolean vcd_dump(struct state *state, struct capture *capture)
 {
 	struct vcd_state s = {
 		.state = state,
-		.samples = samples
+		.capture = capture
 	};
+	gboolean success = FALSE;
 
-	if (state->outfile == NULL)
-		s.out = stdout;
-	else {
-		if ((s.out = fopen(state->outfile, "w")) == NULL) {
-			perror(state->outfile);
-			return FALSE;
-		}
-	}
+	s.ids = g_malloc(MAX(state->noof_signals, 1) * sizeof(*s.ids));
+	for (gint i = 0; i < state->noof_signals; i++)
+		make_id(i, s.ids[i]);
+
+	s.out = output_open(state->outfile, state->compress,
+			    estimate_size(&s));
+	if (s.out == NULL)
+		goto error;
 
 	if (!write_header(&s)) {
-		fclose(s.out);
-		return FALSE;
+		output_close(s.out);
+		goto error;
 	}
 
 	dump_values(&s);
-	fclose(s.out);
-	return TRUE;
+	success = output_close(s.out);
+error:
+	g_free(s.ids);
+	return success;
 }
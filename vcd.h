@@ -25,7 +25,21 @@
 #define _VCD_H_
 
 #include "state.h"
+#include "capture.h"
 
-gboolean vcd_dump(struct state *state, guint8 *samples);
+gboolean vcd_dump(struct state *state, struct capture *capture);
+
+/* Dump time unit: multiplier * 10^exponent seconds, one sample */
+void vcd_timescale(struct state *state, gint *exponent, gint *multiplier);
+
+/*
+ * Find the next sample after 'after' which goes into the dump: a
+ * sample where a channel changes, the trigger point or the last
+ * sample. Returns -1 when there are no more samples. Start with
+ * after = 0 and *change = 0, diff is set to the channels which
+ * changed at the returned sample.
+ */
+gint vcd_next_dump_point(struct capture *capture, gint after,
+			 gint *change, sample_t *diff);
 
 #endif /* _VCD_H_ */
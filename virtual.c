@@ -0,0 +1,289 @@
+/* -*- linux-c -*-
+ *
+ * Virtual signals computed from the captured channels
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "virtual.h"
+
+/*
+ * Expressions are parsed by recursive descent with the precedence of
+ * C, '&' binds tighter than '^' which binds tighter than '|'. Every
+ * value is a vector of channels, bit n of the value is channel n of
+ * the vector. Operators work bit by bit and a one bit operand is
+ * extended to the width of the other.
+ */
+struct operand {
+	gint width;
+	gint channels[MAX_SIGNAL_BITS];
+};
+
+struct parser {
+	struct state *state;
+	gchar *expr;
+	gchar *p;
+};
+
+static void parse_error(struct parser *parser, gchar *what)
+{
+	fprintf(stderr, "Expected %s at '%s' in signal expression '%s'\n",
+		what, parser->p, parser->expr);
+	exit(1);
+}
+
+static void skip_space(struct parser *parser)
+{
+	while (isspace(*parser->p))
+		parser->p++;
+}
+
+static void parse_expr(struct parser *parser, struct operand *r);
+
+static void parse_operand(struct parser *parser, struct operand *r)
+{
+	skip_space(parser);
+	if (isdigit(*parser->p)) {
+		/* A physical channel */
+		gchar *tail;
+		glong channel = strtol(parser->p, &tail, 0);
+
+		if (channel >= NOOF_PHYSICAL_CHANNELS) {
+			fprintf(stderr, "Unsupported channel number %ld in "
+				"signal expression '%s'\n",
+				channel, parser->expr);
+			exit(1);
+		}
+		parser->p = tail;
+		r->width = 1;
+		r->channels[0] = channel;
+	} else if (isalpha(*parser->p) || *parser->p == '_') {
+		gchar *start = parser->p;
+		gchar *name;
+		struct signal_def *s;
+		gint bit = 0;
+
+		while (isalnum(*parser->p) || *parser->p == '_')
+			parser->p++;
+		name = g_strndup(start, parser->p - start);
+		s = state_lookup_signal(parser->state, name);
+		if (s == NULL) {
+			fprintf(stderr, "Signal %s used in signal expression "
+				"'%s' is not defined\n", name, parser->expr);
+			exit(1);
+		}
+		g_free(name);
+
+		r->width = s->noof_bits;
+		memcpy(r->channels, s->channels,
+		       s->noof_bits * sizeof(*r->channels));
+
+		skip_space(parser);
+		if (*parser->p == '[') {
+			/* A single bit of a signal */
+			gchar *tail;
+
+			parser->p++;
+			bit = strtol(parser->p, &tail, 0);
+			if (tail == parser->p || bit < 0 || bit >= r->width)
+				parse_error(parser, "a bit of the signal");
+			parser->p = tail;
+			skip_space(parser);
+			if (*parser->p++ != ']')
+				parse_error(parser, "']'");
+			r->channels[0] = r->channels[bit];
+			r->width = 1;
+		}
+	} else if (*parser->p == '(') {
+		parser->p++;
+		parse_expr(parser, r);
+		skip_space(parser);
+		if (*parser->p++ != ')')
+			parse_error(parser, "')'");
+	} else
+		parse_error(parser, "a signal, channel or '('");
+}
+
+static void parse_unary(struct parser *parser, struct operand *r)
+{
+	skip_space(parser);
+	if (*parser->p == '~') {
+		parser->p++;
+		parse_unary(parser, r);
+		for (gint b = 0; b < r->width; b++)
+			r->channels[b] = state_add_virtual_channel(
+				parser->state, VIRTUAL_NOT, r->channels[b], -1);
+	} else if (*parser->p == '!') {
+		/* Logical not, one if all bits are zero */
+		gint any;
+
+		parser->p++;
+		parse_unary(parser, r);
+		any = r->channels[0];
+		for (gint b = 1; b < r->width; b++)
+			any = state_add_virtual_channel(
+				parser->state, VIRTUAL_OR, any, r->channels[b]);
+		r->channels[0] = state_add_virtual_channel(
+			parser->state, VIRTUAL_NOT, any, -1);
+		r->width = 1;
+	} else
+		parse_operand(parser, r);
+}
+
+static void combine(struct parser *parser, enum virtual_op op,
+		    struct operand *r, struct operand *b)
+{
+	gint width = MAX(r->width, b->width);
+
+	if (r->width != b->width && r->width != 1 && b->width != 1) {
+		fprintf(stderr, "Operands of different widths (%d and %d) in "
+			"signal expression '%s'\n",
+			r->width, b->width, parser->expr);
+		exit(1);
+	}
+	for (gint i = 0; i < width; i++)
+		r->channels[i] = state_add_virtual_channel(
+			parser->state, op,
+			r->channels[r->width == 1 ? 0 : i],
+			b->channels[b->width == 1 ? 0 : i]);
+	r->width = width;
+}
+
+static void parse_and(struct parser *parser, struct operand *r)
+{
+	parse_unary(parser, r);
+	for (skip_space(parser); *parser->p == '&'; skip_space(parser)) {
+		struct operand b;
+
+		parser->p++;
+		parse_unary(parser, &b);
+		combine(parser, VIRTUAL_AND, r, &b);
+	}
+}
+
+static void parse_xor(struct parser *parser, struct operand *r)
+{
+	parse_and(parser, r);
+	for (skip_space(parser); *parser->p == '^'; skip_space(parser)) {
+		struct operand b;
+
+		parser->p++;
+		parse_and(parser, &b);
+		combine(parser, VIRTUAL_XOR, r, &b);
+	}
+}
+
+static void parse_expr(struct parser *parser, struct operand *r)
+{
+	parse_xor(parser, r);
+	for (skip_space(parser); *parser->p == '|'; skip_space(parser)) {
+		struct operand b;
+
+		parser->p++;
+		parse_xor(parser, &b);
+		combine(parser, VIRTUAL_OR, r, &b);
+	}
+}
+
+void virtual_add_signal(struct state *state, gchar *name, gchar *expr)
+{
+	struct parser parser = {
+		.state = state,
+		.expr = expr,
+		.p = expr
+	};
+	struct operand r;
+
+	parse_expr(&parser, &r);
+	skip_space(&parser);
+	if (*parser.p != 0)
+		parse_error(&parser, "an operator");
+
+	state_add_signal(state, name, r.channels, r.width);
+}
+
+static guint64 *get_plane(struct capture *capture, guint64 **planes,
+			  gint channel)
+{
+	if (planes[channel] == NULL)
+		planes[channel] = capture_bitplane(capture, channel);
+	return planes[channel];
+}
+
+/*
+ * The virtual channels are computed on bitplanes, so each operation
+ * handles 64 samples in a single word. The result is then scattered
+ * back into the sample words.
+ */
+void virtual_compute(struct capture *capture)
+{
+	struct state *state = capture->state;
+	gint n = capture->noof_samples;
+	gint words = (n + 63) / 64;
+	guint64 *planes[CAPTURE_NOOF_CHANNELS];
+
+	if (state->noof_virtual_channels == 0)
+		return;
+
+	memset(planes, 0, sizeof(planes));
+	for (gint v = 0; v < state->noof_virtual_channels; v++) {
+		struct virtual_channel *vc = &state->virtual_channels[v];
+		guint64 *a = get_plane(capture, planes, vc->a);
+		guint64 *b = vc->op == VIRTUAL_NOT
+			? a : get_plane(capture, planes, vc->b);
+		guint64 *r = g_malloc(MAX(words, 1) * sizeof(*r));
+
+		switch (vc->op) {
+		case VIRTUAL_NOT:
+			for (gint w = 0; w < words; w++)
+				r[w] = ~a[w];
+			break;
+		case VIRTUAL_AND:
+			for (gint w = 0; w < words; w++)
+				r[w] = a[w] & b[w];
+			break;
+		case VIRTUAL_OR:
+			for (gint w = 0; w < words; w++)
+				r[w] = a[w] | b[w];
+			break;
+		case VIRTUAL_XOR:
+			for (gint w = 0; w < words; w++)
+				r[w] = a[w] ^ b[w];
+			break;
+		}
+		planes[NOOF_PHYSICAL_CHANNELS + v] = r;
+	}
+
+	for (gint i = 0; i < n; i++) {
+		sample_t s = capture->samples[i]
+			& (((sample_t)1 << NOOF_PHYSICAL_CHANNELS) - 1);
+
+		for (gint v = 0; v < state->noof_virtual_channels; v++)
+			s |= ((planes[NOOF_PHYSICAL_CHANNELS + v][i / 64]
+			       >> (i % 64)) & 1)
+				<< (NOOF_PHYSICAL_CHANNELS + v);
+		capture->samples[i] = s;
+	}
+
+	for (gint c = 0; c < CAPTURE_NOOF_CHANNELS; c++)
+		g_free(planes[c]);
+}
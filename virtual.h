@@ -0,0 +1,40 @@
+/* -*- linux-c -*-
+ *
+ * Virtual signals computed from the captured channels
+ *
+ * This file is part of oblsc.
+ *
+ * Copyright (C) 2010-2011 Frej Drejhammar <frej.drejhammar@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef _VIRTUAL_H_
+#define _VIRTUAL_H_
+
+#include <glib.h>
+#include "state.h"
+#include "capture.h"
+
+/*
+ * Compile the expression into virtual channels and define the signal
+ * name from them. Exits on a malformed expression.
+ */
+void virtual_add_signal(struct state *state, gchar *name, gchar *expr);
+
+/* Fill in the virtual channels of the unpacked samples */
+void virtual_compute(struct capture *capture);
+
+#endif /* _VIRTUAL_H_ */